@@ -0,0 +1,430 @@
+/*
+// Copyright (c) 2016 Eliott Paris.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+//! @brief Offline benchmark of the perform routines of the pa.* objects.
+//! @details Each class is created through its setup method, instantiated with the arguments
+//! and messages of its entry in the benchmarks table, then its dsp chain is run
+//! for a number of blocks and the mean time per sample is reported.
+
+#include "pdstub.h"
+#include "bench_setups.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //! @brief How to create and feed an object.
+    struct Benchmark
+    {
+        const char* name;       //!< class name
+        const char* variant;    //!< short description of the case
+        const char* args;       //!< creation arguments
+        const char* messages;   //!< messages sent after creation ("selector args, selector args")
+        const char* inputs;     //!< one token per signal inlet: a number or "noise"
+    };
+
+    //! @brief Benchmarks of the objects, the classes that are not listed run with default settings.
+    const Benchmark benchmarks[] =
+    {
+        {"pa.clip~",        "",             "-0.5 0.5",         "",                 "noise"},
+        {"pa.clip~",        "tanh",         "-0.5 0.5",         "mode tanh",        "noise"},
+        {"pa.clip~",        "cubic",        "-0.5 0.5",         "mode cubic",       "noise"},
+        {"pa.clip~",        "signal",       "-signal -0.5 0.5", "",                 "noise noise noise"},
+        {"pa.count~",       "",             "0 44100",          "",                 ""},
+        {"pa.delay1~",      "",             "",                 "",                 "noise"},
+        {"pa.delay2~",      "",             "4410",             "",                 "noise"},
+        {"pa.delay3~",      "",             "4410",             "size 1000",        "noise"},
+        {"pa.delay4~",      "",             "4410",             "",                 "noise 1000.5"},
+        {"pa.delay4~",      "hermite",      "4410",             "interp hermite",   "noise 1000.5"},
+        {"pa.delay5~",      "8 taps",       "44100 8",          "",                 "noise 100.5 200.5 300.5 400.5 500.5 600.5 700.5 800.5"},
+        {"pa.delay5~",      "8 hermite",    "44100 8",          "interp hermite",   "noise 100.5 200.5 300.5 400.5 500.5 600.5 700.5 800.5"},
+        {"pa.delay5~",      "8 lagrange",   "44100 8",          "interp lagrange",  "noise 100.5 200.5 300.5 400.5 500.5 600.5 700.5 800.5"},
+        {"pa.delay5~",      "8 allpass",    "44100 8",          "interp allpass",   "noise 100.5 200.5 300.5 400.5 500.5 600.5 700.5 800.5"},
+        {"pa.delay5~",      "16 taps 10 s", "480000 16",        "",                 "noise 310000.5 12000.5 450000.5 87000.5 230000.5 3000.5 390000.5 150000.5 41000.5 270000.5 199000.5 470000.5 64000.5 350000.5 118000.5 430000.5"},
+        {"pa.delread~",     "",             "bench-delay",      "",                 "1000.5"},
+        {"pa.delread~",     "hermite",      "bench-delay",      "interp hermite",   "1000.5"},
+        {"pa.delwrite~",    "",             "bench-delwrite 44100", "",             "noise"},
+        {"pa.fdn~",         "16 lines",     "16 48000",         "feedback 0.8",     "noise"},
+        {"pa.fdn~",         "16 hadamard",  "16 48000",         "matrix hadamard",  "noise"},
+        {"pa.fdn~",         "16 short",     "16 48000",         "delays 13 17 19 23 29 31 37 41 43 47 53 59 61 67 71 73", "noise"},
+        {"pa.granular~",    "64 grains",    "bench-array 64",   "",                 "noise 0.5 1.5"},
+        {"pa.granular~",    "512 grains",   "bench-array 512",  "",                 "noise 0.5 1.5"},
+        {"pa.granular~",    "512 mmap",     "bench-mmap 512",   "",                 "noise 0.5 1.5"},
+        {"pa.gain~",        "steady",       "",                 "gain 0.5",         "noise"},
+        {"pa.gain~",        "unity",        "",                 "gain 1",           "noise"},
+        {"pa.gain~",        "mute",         "",                 "gain 0",           "noise"},
+        {"pa.gain~",        "8 steady",     "8",                "gain 0.5",         "noise noise noise noise noise noise noise noise"},
+        {"pa.limiter~",     "",             "1 5 0.5",          "",                 "noise"},
+        {"pa.limiter~",     "64 channels",  "64 5 0.5",         "",                 "noise"},
+        {"pa.limiter~",     "64 idle",      "64 5 2",           "",                 "noise"},
+        {"pa.osc1~",        "",             "",                 "",                 "440"},
+        {"pa.osc2~",        "",             "",                 "",                 "440"},
+        {"pa.osc3~",        "",             "",                 "",                 "440"},
+        {"pa.oscbank~",     "512 partials", "",                 "@partials 512",    ""},
+        {"pa.oscpp~",       "",             "",                 "",                 "440"},
+        {"pa.phasor~",      "",             "",                 "",                 "440"},
+        {"pa.phasorpp~",    "",             "",                 "",                 "440"},
+        {"pa.readbuffer1~", "",             "bench-array",      "",                 "0.25"},
+        {"pa.readbuffer1~", "mmap",         "bench-mmap",       "",                 "0.25"},
+        {"pa.readbuffer2~", "",             "bench-array",      "",                 "1.5"},
+        {"pa.readbuffer2~", "mmap",         "bench-mmap",       "",                 "1.5"},
+        {"pa.readbuffer2~", "sinc",         "bench-array",      "interp sinc",      "0.75"},
+        {"pa.readbuffer2~", "sinc 1.5",     "bench-array",      "interp sinc",      "1.5"},
+        {"pa.readbuffer2~", "sinc reverse", "bench-array",      "interp sinc",      "-0.75"},
+        {"pa.readbuffer2~", "sinc -0.001",  "bench-array",      "interp sinc",      "-0.001"},
+        {"pa.readbuffer2~", "-0.001",       "bench-array",      "",                 "-0.001"},
+        {"pa.readbuffer2~", "mmap sinc",    "bench-mmap",       "interp sinc",      "0.75"},
+        {"pa.readbuffermc~", "8 arrays",    "bench-array bench-array bench-array bench-array bench-array bench-array bench-array bench-array", "", "1.5"},
+        {"pa.readbuffermc~", "2 mmap",      "bench-mmap 2",     "",                 "1.5"},
+        {"pa.sah~",         "",             "0.5",              "",                 "noise noise"},
+        {"pa.snapshot~",    "",             "10",               "",                 "noise"},
+    };
+
+    const char* bench_array_name = "bench-array";
+
+    //! @brief A stereo WAV file of 32-bit floats written before the benchmarks, mapped by the bench-mmap source.
+    const char* bench_soundfile_name = "bench-mmapsource.wav";
+
+    //! @brief Objects created before the benchmarks and used by them (class name, arguments).
+    const char* const bench_helpers[][2] =
+    {
+        {"pa.delwrite~",    "bench-delay 44100"},
+        {"pa.mmapsource",   "bench-mmap bench-mmapsource.wav"},
+    };
+
+    struct Options
+    {
+        long        blocks = 100000;
+        int         vecsize = 64;
+        float       samplerate = 48000.f;
+        int         runs = 5;
+        bool        inplace = false;
+        bool        verbose = false;
+        std::string filter;
+    };
+
+    void usage()
+    {
+        std::printf("usage: bench [options] [filter]\n"
+                    "  -b, --blocks N      number of blocks per run (default 100000)\n"
+                    "  -n, --vecsize N     block size in samples (default 64)\n"
+                    "  -s, --samplerate N  sampling rate (default 48000)\n"
+                    "  -r, --runs N        number of runs, the median run is reported (default 5)\n"
+                    "  -i, --inplace       share the first inlet and outlet buffer, like Pd often does\n"
+                    "  -v, --verbose       print the messages posted by the objects\n"
+                    "  filter              only run the objects whose name contains this string\n");
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool has_value = (i + 1 < argc);
+
+            if((arg == "-b" || arg == "--blocks") && has_value) options.blocks = std::atol(argv[++i]);
+            else if((arg == "-n" || arg == "--vecsize") && has_value) options.vecsize = std::atoi(argv[++i]);
+            else if((arg == "-s" || arg == "--samplerate") && has_value) options.samplerate = (float)std::atof(argv[++i]);
+            else if((arg == "-r" || arg == "--runs") && has_value) options.runs = std::atoi(argv[++i]);
+            else if(arg == "-i" || arg == "--inplace") options.inplace = true;
+            else if(arg == "-v" || arg == "--verbose") options.verbose = true;
+            else if(arg == "-h" || arg == "--help") return false;
+            else if(!arg.empty() && arg[0] != '-') options.filter = arg;
+            else return false;
+        }
+
+        return options.blocks > 0 && options.vecsize > 0 && options.samplerate > 0.f && options.runs > 0;
+    }
+
+    std::vector<std::string> split(const char* text, char separator)
+    {
+        std::vector<std::string> tokens;
+        std::string token;
+
+        for(const char* c = text; c && *c; ++c)
+        {
+            if(*c == separator)
+            {
+                tokens.push_back(token);
+                token.clear();
+            }
+            else
+            {
+                token += *c;
+            }
+        }
+
+        if(!token.empty()) tokens.push_back(token);
+        return tokens;
+    }
+
+    std::string trim(std::string const& text)
+    {
+        const size_t first = text.find_first_not_of(' ');
+        const size_t last = text.find_last_not_of(' ');
+        return (first == std::string::npos) ? std::string() : text.substr(first, last - first + 1);
+    }
+
+    //! @brief Send the messages of a benchmark to an object.
+    //! @details "@partials N" is expanded to a list of N frequencies.
+    void sendMessages(t_object* x, const char* messages)
+    {
+        for(std::string const& message : split(messages, ','))
+        {
+            const std::string text = trim(message);
+            if(text.empty()) continue;
+
+            const size_t space = text.find(' ');
+            const std::string selector = text.substr(0, space);
+            const std::string args = (space == std::string::npos) ? std::string() : text.substr(space + 1);
+
+            if(selector == "@partials")
+            {
+                std::string freqs;
+                const int count = std::atoi(args.c_str());
+                for(int i = 0; i < count; ++i)
+                {
+                    freqs += std::to_string(55. + i * 27.5) + " ";
+                }
+
+                pdstub_object_send(x, "list", freqs.c_str());
+            }
+            else
+            {
+                pdstub_object_send(x, selector.c_str(), args.c_str());
+            }
+        }
+    }
+
+    //! @brief Write a stereo WAV file of 32-bit float noise (the host is expected to be little-endian).
+    bool writeSoundFile(const char* path, uint32_t frames)
+    {
+        FILE* file = std::fopen(path, "wb");
+        if(!file)
+        {
+            return false;
+        }
+
+        const uint16_t channels = 2, bits = 32, tag = 3, align = channels * bits / 8;
+        const uint32_t fmtsize = 16, samplerate = 48000, byterate = samplerate * align;
+        const uint32_t datasize = frames * align, riffsize = 4 + (8 + fmtsize) + (8 + datasize);
+
+        std::fwrite("RIFF", 1, 4, file);
+        std::fwrite(&riffsize, 4, 1, file);
+        std::fwrite("WAVEfmt ", 1, 8, file);
+        std::fwrite(&fmtsize, 4, 1, file);
+        std::fwrite(&tag, 2, 1, file);
+        std::fwrite(&channels, 2, 1, file);
+        std::fwrite(&samplerate, 4, 1, file);
+        std::fwrite(&byterate, 4, 1, file);
+        std::fwrite(&align, 2, 1, file);
+        std::fwrite(&bits, 2, 1, file);
+        std::fwrite("data", 1, 4, file);
+        std::fwrite(&datasize, 4, 1, file);
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+        std::vector<float> samples(frames * channels);
+        for(float& sample : samples)
+        {
+            sample = noise(rng);
+        }
+
+        const bool written = std::fwrite(samples.data(), sizeof(float), samples.size(), file) == samples.size();
+        return (std::fclose(file) == 0) && written;
+    }
+
+    struct Result
+    {
+        double ns_per_block;
+        double ns_per_sample;
+    };
+
+    bool run(t_class* c, Benchmark const& benchmark, Options const& options, Result& result)
+    {
+        t_object* x = pdstub_object_new(c, benchmark.args);
+        if(!x)
+        {
+            return false;
+        }
+
+        sendMessages(x, benchmark.messages);
+
+        const int vecsize = options.vecsize;
+        const int nins = pdstub_object_nsiginlets(x);
+        const int nouts = pdstub_object_nsigoutlets(x);
+
+        // allocate and fill the signal vectors
+        std::vector<std::vector<t_sample>> buffers(nins + nouts, std::vector<t_sample>(vecsize, 0.f));
+        std::vector<t_signal> signals(nins + nouts);
+        std::vector<t_signal*> sp(nins + nouts);
+        std::vector<std::string> inputs = split(benchmark.inputs, ' ');
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+
+        for(int i = 0; i < nins + nouts; ++i)
+        {
+            if(i < nins)
+            {
+                const std::string input = (i < (int)inputs.size()) ? inputs[i] : std::string(i == 0 ? "noise" : "0");
+                for(t_sample& sample : buffers[i])
+                {
+                    sample = (input == "noise") ? noise(rng) : (t_sample)std::atof(input.c_str());
+                }
+            }
+
+            // Pd often uses the same buffer for the first inlet and the first outlet
+            const bool shared = options.inplace && i == nins && nins > 0;
+
+            signals[i].s_n = vecsize;
+            signals[i].s_sr = options.samplerate;
+            signals[i].s_vec = shared ? buffers[0].data() : buffers[i].data();
+            sp[i] = &signals[i];
+        }
+
+        pdstub_object_dsp(x, sp.data());
+
+        // the input buffers are refreshed at each block since outputs may overwrite them
+        std::vector<std::vector<t_sample>> sources(buffers.begin(), buffers.begin() + nins);
+        auto tick = [&]()
+        {
+            if(options.inplace && nins > 0)
+            {
+                std::copy(sources[0].begin(), sources[0].end(), buffers[0].begin());
+            }
+            pdstub_dsp_tick();
+        };
+
+        // warm up caches and branch predictors
+        for(long i = 0; i < std::min(options.blocks, 1000l); ++i)
+        {
+            tick();
+        }
+
+        std::vector<double> timings;
+        for(int r = 0; r < options.runs; ++r)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            for(long i = 0; i < options.blocks; ++i)
+            {
+                tick();
+            }
+
+            const auto end = std::chrono::steady_clock::now();
+            timings.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+
+        std::sort(timings.begin(), timings.end());
+        const double median = timings[timings.size() / 2];
+
+        result.ns_per_block = median / options.blocks;
+        result.ns_per_sample = result.ns_per_block / vecsize;
+
+        pdstub_object_free(x);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    pdstub_setverbose(options.verbose ? 1 : 0);
+    pdstub_setdsp(options.samplerate, options.vecsize);
+
+    // arrays must exist before the objects that read them are created
+    pdstub_array_new(bench_array_name, (int)options.samplerate);
+    if(!writeSoundFile(bench_soundfile_name, (uint32_t)options.samplerate))
+    {
+        std::printf("# can't write %s\n", bench_soundfile_name);
+    }
+
+    for(auto setup : bench_setups)
+    {
+        setup();
+    }
+
+    std::vector<t_object*> helpers;
+    for(auto const& helper : bench_helpers)
+    {
+        for(int i = 0; i < pdstub_getnclasses(); ++i)
+        {
+            t_class* c = pdstub_getclass(i);
+            if(std::strcmp(class_getname(c), helper[0]) == 0)
+            {
+                helpers.push_back(pdstub_object_new(c, helper[1]));
+            }
+        }
+    }
+
+    std::printf("# sr: %g Hz, block size: %d, blocks per run: %ld, runs: %d%s\n",
+                options.samplerate, options.vecsize, options.blocks, options.runs,
+                options.inplace ? ", in place" : "");
+    std::printf("%-20s %-16s %14s %12s\n", "object", "variant", "ns/block", "ns/sample");
+
+    int failures = 0;
+
+    for(int i = 0; i < pdstub_getnclasses(); ++i)
+    {
+        t_class* c = pdstub_getclass(i);
+        const char* name = class_getname(c);
+
+        if(!pdstub_class_hasdsp(c)) continue;
+        if(!options.filter.empty() && std::strstr(name, options.filter.c_str()) == nullptr) continue;
+
+        std::vector<Benchmark> cases;
+        for(Benchmark const& benchmark : benchmarks)
+        {
+            if(std::strcmp(benchmark.name, name) == 0) cases.push_back(benchmark);
+        }
+
+        if(cases.empty())
+        {
+            cases.push_back({name, "default", "", "", ""});
+        }
+
+        for(Benchmark const& benchmark : cases)
+        {
+            Result result;
+            if(run(c, benchmark, options, result))
+            {
+                std::printf("%-20s %-16s %14.1f %12.3f\n", name, benchmark.variant,
+                            result.ns_per_block, result.ns_per_sample);
+            }
+            else
+            {
+                std::printf("%-20s %-16s %14s %12s\n", name, benchmark.variant, "failed", "-");
+                failures++;
+            }
+
+            std::fflush(stdout);
+        }
+    }
+
+    for(t_object* helper : helpers)
+    {
+        if(helper) pdstub_object_free(helper);
+    }
+
+    std::remove(bench_soundfile_name);
+
+    return failures ? 1 : 0;
+}
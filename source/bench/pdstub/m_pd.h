@@ -0,0 +1,192 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+// A stub of the part of the Pure Data API used by the pa.* objects.
+// It lets the benchmark host (see ../bench.cpp) build and run the objects without Pd,
+// only the declarations used by the objects of this repository are provided.
+
+#ifndef __m_pd_h_
+#define __m_pd_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PD_MAJOR_VERSION 0
+#define PD_MINOR_VERSION 47
+
+#define EXTERN extern
+
+#define MAXPDSTRING 1000
+
+#ifdef _WIN64
+typedef long long t_int;
+#else
+typedef long t_int;
+#endif
+typedef float t_float;
+typedef float t_floatarg;
+typedef float t_sample;
+
+typedef struct _class t_class;
+typedef t_class* t_pd;
+
+typedef struct _symbol
+{
+    const char*     s_name;
+    t_pd*           s_thing;
+    struct _symbol* s_next;
+} t_symbol;
+
+typedef struct _gpointer t_gpointer;
+
+typedef union word
+{
+    t_float     w_float;
+    t_symbol*   w_symbol;
+    t_gpointer* w_gpointer;
+    int         w_index;
+} t_word;
+
+typedef enum
+{
+    A_NULL,
+    A_FLOAT,
+    A_SYMBOL,
+    A_POINTER,
+    A_SEMI,
+    A_COMMA,
+    A_DEFFLOAT,
+    A_DEFSYM,
+    A_DOLLAR,
+    A_DOLLSYM,
+    A_GIMME,
+    A_CANT
+} t_atomtype;
+
+typedef struct _atom
+{
+    t_atomtype  a_type;
+    union word  a_w;
+} t_atom;
+
+typedef struct _object
+{
+    t_pd        ob_pd;
+} t_object;
+
+typedef struct _outlet t_outlet;
+typedef struct _inlet t_inlet;
+typedef struct _clock t_clock;
+typedef struct _garray t_garray;
+typedef struct _glist t_canvas;
+
+typedef struct _signal
+{
+    int         s_n;
+    t_sample*   s_vec;
+    t_float     s_sr;
+} t_signal;
+
+typedef void (*t_method)(void);
+typedef void* (*t_newmethod)(void);
+typedef t_int* (*t_perfroutine)(t_int* args);
+
+// -------------------------------------------------------------------------------- //
+// symbols, classes and objects
+
+EXTERN t_symbol s_;
+EXTERN t_symbol s_bang;
+EXTERN t_symbol s_float;
+EXTERN t_symbol s_symbol;
+EXTERN t_symbol s_list;
+EXTERN t_symbol s_signal;
+
+EXTERN t_symbol* gensym(const char* s);
+
+#define CLASS_DEFAULT 0
+
+EXTERN t_class* class_new(t_symbol* name, t_newmethod newmethod, t_method freemethod,
+                          size_t size, int flags, t_atomtype arg1, ...);
+EXTERN void class_addmethod(t_class* c, t_method fn, t_symbol* sel, t_atomtype arg1, ...);
+EXTERN void class_addbang(t_class* c, t_method fn);
+EXTERN void class_domainsignalin(t_class* c, int onset);
+EXTERN const char* class_getname(const t_class* c);
+
+#define CLASS_MAINSIGNALIN(c, type, field) \
+    class_domainsignalin(c, (char *)(&((type *)0)->field) - (char *)0)
+
+EXTERN t_pd* pd_new(t_class* cls);
+#define pd_class(x) (*(x))
+EXTERN void pd_bind(t_pd* x, t_symbol* s);
+EXTERN void pd_unbind(t_pd* x, t_symbol* s);
+EXTERN t_pd* pd_findbyclass(t_symbol* s, t_class* c);
+
+// -------------------------------------------------------------------------------- //
+// inlets and outlets
+
+EXTERN t_inlet* inlet_new(t_object* owner, t_pd* dest, t_symbol* s1, t_symbol* s2);
+EXTERN t_inlet* signalinlet_new(t_object* owner, t_float f);
+EXTERN t_inlet* floatinlet_new(t_object* owner, t_float* fp);
+EXTERN void inlet_free(t_inlet* x);
+
+EXTERN t_outlet* outlet_new(t_object* owner, t_symbol* s);
+EXTERN void outlet_free(t_outlet* x);
+EXTERN void outlet_bang(t_outlet* x);
+EXTERN void outlet_float(t_outlet* x, t_float f);
+EXTERN void outlet_symbol(t_outlet* x, t_symbol* s);
+EXTERN void outlet_list(t_outlet* x, t_symbol* s, int argc, t_atom* argv);
+
+// -------------------------------------------------------------------------------- //
+// atoms
+
+EXTERN t_float atom_getfloat(const t_atom* a);
+
+// -------------------------------------------------------------------------------- //
+// printing
+
+EXTERN void post(const char* fmt, ...);
+EXTERN void error(const char* fmt, ...);
+EXTERN void pd_error(void* object, const char* fmt, ...);
+
+// -------------------------------------------------------------------------------- //
+// dsp
+
+EXTERN void dsp_add(t_perfroutine f, int n, ...);
+EXTERN void dsp_addv(t_perfroutine f, int n, t_int* vec);
+EXTERN t_float sys_getsr(void);
+EXTERN int sys_getblksize(void);
+EXTERN int pd_getdspstate(void);
+EXTERN void canvas_update_dsp(void);
+EXTERN int ugen_getsortno(void);
+
+// -------------------------------------------------------------------------------- //
+// clocks
+
+EXTERN t_clock* clock_new(void* owner, t_method fn);
+EXTERN void clock_free(t_clock* x);
+EXTERN void clock_delay(t_clock* x, double delaytime);
+EXTERN void clock_unset(t_clock* x);
+EXTERN double clock_getlogicaltime(void);
+EXTERN double clock_gettimesince(double prevsystime);
+
+// -------------------------------------------------------------------------------- //
+// arrays and canvases
+
+EXTERN t_class* garray_class;
+EXTERN int garray_getfloatwords(t_garray* x, int* size, t_word** vec);
+EXTERN void garray_usedindsp(t_garray* x);
+
+EXTERN t_canvas* canvas_getcurrent(void);
+EXTERN t_symbol* canvas_getdir(t_canvas* x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __m_pd_h_
@@ -0,0 +1,817 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A minimal implementation of the Pd API used by the pa.* objects.
+//! @details Only what is needed to create the objects, send them messages,
+//! and build and run their dsp chain is implemented (see pdstub.h).
+
+#include "pdstub.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#define PDSTUB_MAXARGS 6
+
+// ================================================================================ //
+//                                      STATE                                       //
+// ================================================================================ //
+
+typedef struct _method
+{
+    t_symbol*   m_sel;
+    t_method    m_fn;
+    t_atomtype  m_args[PDSTUB_MAXARGS];
+    int         m_nargs;
+} t_method_entry;
+
+struct _class
+{
+    t_symbol*       c_name;
+    t_newmethod     c_new;
+    t_method        c_free;
+    size_t          c_size;
+    t_atomtype      c_args[PDSTUB_MAXARGS];
+    int             c_nargs;
+    t_method_entry* c_methods;
+    int             c_nmethods;
+    int             c_mainsignalin;
+};
+
+struct _inlet
+{
+    t_object*   i_owner;
+    int         i_signal;
+};
+
+struct _outlet
+{
+    t_object*   o_owner;
+    t_symbol*   o_sym;
+};
+
+struct _clock
+{
+    void*       c_owner;
+    t_method    c_fn;
+    double      c_settime;
+    int         c_set;
+};
+
+struct _garray
+{
+    t_pd        g_pd;
+    t_symbol*   g_name;
+    t_word*     g_vec;
+    int         g_size;
+};
+
+typedef struct _iocount
+{
+    t_object*   x;
+    int         nsigin;
+    int         nsigout;
+} t_iocount;
+
+typedef struct _binding
+{
+    t_symbol*   s;
+    t_pd*       x;
+} t_binding;
+
+t_symbol s_        = {"", 0, 0};
+t_symbol s_bang    = {"bang", 0, 0};
+t_symbol s_float   = {"float", 0, 0};
+t_symbol s_symbol  = {"symbol", 0, 0};
+t_symbol s_list    = {"list", 0, 0};
+t_symbol s_signal  = {"signal", 0, 0};
+
+t_class* garray_class = NULL;
+
+static t_symbol*    stub_symbols = NULL;
+static t_class**    stub_classes = NULL;
+static int          stub_nclasses = 0;
+static t_iocount*   stub_iocounts = NULL;
+static int          stub_niocounts = 0;
+static t_binding*   stub_bindings = NULL;
+static int          stub_nbindings = 0;
+static t_clock**    stub_clocks = NULL;
+static int          stub_nclocks = 0;
+static t_int**      stub_chain = NULL;
+static int          stub_nchain = 0;
+static t_float      stub_sr = 44100.f;
+static int          stub_blocksize = 64;
+static double       stub_time = 0.;
+static int          stub_sortno = 0;
+static int          stub_verbose = 0;
+static int          stub_initialized = 0;
+
+static void stub_init(void)
+{
+    if(stub_initialized) return;
+    stub_initialized = 1;
+
+    t_symbol* builtins[] = {&s_, &s_bang, &s_float, &s_symbol, &s_list, &s_signal};
+    int i = 0;
+    for(; i < (int)(sizeof(builtins) / sizeof(builtins[0])); ++i)
+    {
+        builtins[i]->s_next = stub_symbols;
+        stub_symbols = builtins[i];
+    }
+
+    // the array class is not part of the classes reported to the host.
+    garray_class = (t_class*)calloc(1, sizeof(t_class));
+    garray_class->c_name = gensym("array");
+    garray_class->c_size = sizeof(t_garray);
+    garray_class->c_mainsignalin = -1;
+}
+
+static t_iocount* stub_getiocount(t_object* x)
+{
+    int i = 0;
+    for(; i < stub_niocounts; ++i)
+    {
+        if(stub_iocounts[i].x == x) return &stub_iocounts[i];
+    }
+
+    stub_iocounts = (t_iocount*)realloc(stub_iocounts, sizeof(t_iocount) * (stub_niocounts + 1));
+    t_iocount* io = &stub_iocounts[stub_niocounts++];
+    io->x = x;
+    io->nsigin = io->nsigout = 0;
+    return io;
+}
+
+// ================================================================================ //
+//                               SYMBOLS, CLASSES, OBJECTS                          //
+// ================================================================================ //
+
+t_symbol* gensym(const char* s)
+{
+    stub_init();
+
+    t_symbol* sym = stub_symbols;
+    for(; sym; sym = sym->s_next)
+    {
+        if(strcmp(sym->s_name, s) == 0) return sym;
+    }
+
+    sym = (t_symbol*)calloc(1, sizeof(t_symbol));
+    char* name = (char*)malloc(strlen(s) + 1);
+    strcpy(name, s);
+    sym->s_name = name;
+    sym->s_next = stub_symbols;
+    stub_symbols = sym;
+    return sym;
+}
+
+static int stub_readargs(t_atomtype* args, t_atomtype arg1, va_list ap)
+{
+    int n = 0;
+    t_atomtype type = arg1;
+    while(type != A_NULL && n < PDSTUB_MAXARGS)
+    {
+        args[n++] = type;
+        type = (t_atomtype)va_arg(ap, int);
+    }
+    return n;
+}
+
+t_class* class_new(t_symbol* name, t_newmethod newmethod, t_method freemethod,
+                   size_t size, int flags, t_atomtype arg1, ...)
+{
+    stub_init();
+
+    t_class* c = (t_class*)calloc(1, sizeof(t_class));
+    c->c_name = name;
+    c->c_new = newmethod;
+    c->c_free = freemethod;
+    c->c_size = size;
+    c->c_mainsignalin = -1;
+
+    va_list ap;
+    va_start(ap, arg1);
+    c->c_nargs = stub_readargs(c->c_args, arg1, ap);
+    va_end(ap);
+
+    stub_classes = (t_class**)realloc(stub_classes, sizeof(t_class*) * (stub_nclasses + 1));
+    stub_classes[stub_nclasses++] = c;
+    return c;
+}
+
+void class_addmethod(t_class* c, t_method fn, t_symbol* sel, t_atomtype arg1, ...)
+{
+    c->c_methods = (t_method_entry*)realloc(c->c_methods, sizeof(t_method_entry) * (c->c_nmethods + 1));
+    t_method_entry* m = &c->c_methods[c->c_nmethods++];
+    m->m_sel = sel;
+    m->m_fn = fn;
+
+    va_list ap;
+    va_start(ap, arg1);
+    m->m_nargs = stub_readargs(m->m_args, arg1, ap);
+    va_end(ap);
+}
+
+void class_addbang(t_class* c, t_method fn)
+{
+    class_addmethod(c, fn, &s_bang, A_NULL);
+}
+
+void class_domainsignalin(t_class* c, int onset)
+{
+    c->c_mainsignalin = onset;
+}
+
+const char* class_getname(const t_class* c)
+{
+    return c->c_name->s_name;
+}
+
+t_pd* pd_new(t_class* c)
+{
+    t_pd* x = (t_pd*)calloc(1, c->c_size);
+    *x = c;
+    return x;
+}
+
+void pd_bind(t_pd* x, t_symbol* s)
+{
+    stub_bindings = (t_binding*)realloc(stub_bindings, sizeof(t_binding) * (stub_nbindings + 1));
+    stub_bindings[stub_nbindings].s = s;
+    stub_bindings[stub_nbindings].x = x;
+    stub_nbindings++;
+
+    if(!s->s_thing) s->s_thing = x;
+}
+
+void pd_unbind(t_pd* x, t_symbol* s)
+{
+    int i = 0;
+    for(; i < stub_nbindings; ++i)
+    {
+        if(stub_bindings[i].s == s && stub_bindings[i].x == x)
+        {
+            stub_bindings[i] = stub_bindings[--stub_nbindings];
+            break;
+        }
+    }
+
+    s->s_thing = NULL;
+    for(i = 0; i < stub_nbindings; ++i)
+    {
+        if(stub_bindings[i].s == s)
+        {
+            s->s_thing = stub_bindings[i].x;
+            break;
+        }
+    }
+}
+
+t_pd* pd_findbyclass(t_symbol* s, t_class* c)
+{
+    int i = 0;
+    for(; i < stub_nbindings; ++i)
+    {
+        if(stub_bindings[i].s == s && *stub_bindings[i].x == c)
+        {
+            return stub_bindings[i].x;
+        }
+    }
+    return NULL;
+}
+
+// ================================================================================ //
+//                                 INLETS / OUTLETS                                 //
+// ================================================================================ //
+
+t_inlet* inlet_new(t_object* owner, t_pd* dest, t_symbol* s1, t_symbol* s2)
+{
+    t_inlet* x = (t_inlet*)calloc(1, sizeof(t_inlet));
+    x->i_owner = owner;
+    x->i_signal = (s1 == &s_signal);
+    if(x->i_signal) stub_getiocount(owner)->nsigin++;
+    return x;
+}
+
+t_inlet* signalinlet_new(t_object* owner, t_float f)
+{
+    return inlet_new(owner, &owner->ob_pd, &s_signal, &s_signal);
+}
+
+t_inlet* floatinlet_new(t_object* owner, t_float* fp)
+{
+    return inlet_new(owner, NULL, &s_float, NULL);
+}
+
+void inlet_free(t_inlet* x)
+{
+    free(x);
+}
+
+t_outlet* outlet_new(t_object* owner, t_symbol* s)
+{
+    t_outlet* x = (t_outlet*)calloc(1, sizeof(t_outlet));
+    x->o_owner = owner;
+    x->o_sym = s;
+    if(s == &s_signal) stub_getiocount(owner)->nsigout++;
+    return x;
+}
+
+void outlet_free(t_outlet* x)
+{
+    free(x);
+}
+
+void outlet_bang(t_outlet* x) {}
+void outlet_float(t_outlet* x, t_float f) {}
+void outlet_symbol(t_outlet* x, t_symbol* s) {}
+void outlet_list(t_outlet* x, t_symbol* s, int argc, t_atom* argv) {}
+
+// ================================================================================ //
+//                                       ATOMS                                      //
+// ================================================================================ //
+
+t_float atom_getfloat(const t_atom* a)
+{
+    return (a->a_type == A_FLOAT) ? a->a_w.w_float : 0;
+}
+
+// ================================================================================ //
+//                                     PRINTING                                     //
+// ================================================================================ //
+
+void post(const char* fmt, ...)
+{
+    if(!stub_verbose) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+void error(const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fputs("error: ", stderr);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+void pd_error(void* object, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fputs("error: ", stderr);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+// ================================================================================ //
+//                                        DSP                                       //
+// ================================================================================ //
+
+void dsp_addv(t_perfroutine f, int n, t_int* vec)
+{
+    t_int* w = (t_int*)malloc(sizeof(t_int) * (n + 2));
+    w[0] = (t_int)f;
+    memcpy(w + 1, vec, sizeof(t_int) * n);
+    w[n + 1] = n;
+
+    stub_chain = (t_int**)realloc(stub_chain, sizeof(t_int*) * (stub_nchain + 1));
+    stub_chain[stub_nchain++] = w;
+}
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+    t_int vec[64];
+    int i = 0;
+
+    va_list ap;
+    va_start(ap, n);
+    for(; i < n && i < 64; ++i)
+    {
+        vec[i] = va_arg(ap, t_int);
+    }
+    va_end(ap);
+
+    dsp_addv(f, n, vec);
+}
+
+t_float sys_getsr(void)
+{
+    return stub_sr;
+}
+
+int sys_getblksize(void)
+{
+    return stub_blocksize;
+}
+
+int pd_getdspstate(void)
+{
+    return 1;
+}
+
+void canvas_update_dsp(void)
+{
+    ;
+}
+
+int ugen_getsortno(void)
+{
+    return stub_sortno;
+}
+
+// ================================================================================ //
+//                                      CLOCKS                                      //
+// ================================================================================ //
+
+t_clock* clock_new(void* owner, t_method fn)
+{
+    t_clock* x = (t_clock*)calloc(1, sizeof(t_clock));
+    x->c_owner = owner;
+    x->c_fn = fn;
+
+    stub_clocks = (t_clock**)realloc(stub_clocks, sizeof(t_clock*) * (stub_nclocks + 1));
+    stub_clocks[stub_nclocks++] = x;
+    return x;
+}
+
+void clock_free(t_clock* x)
+{
+    int i = 0;
+    for(; i < stub_nclocks; ++i)
+    {
+        if(stub_clocks[i] == x)
+        {
+            stub_clocks[i] = stub_clocks[--stub_nclocks];
+            break;
+        }
+    }
+    free(x);
+}
+
+void clock_delay(t_clock* x, double delaytime)
+{
+    x->c_settime = stub_time + (delaytime > 0. ? delaytime : 0.);
+    x->c_set = 1;
+}
+
+void clock_unset(t_clock* x)
+{
+    x->c_set = 0;
+}
+
+double clock_getlogicaltime(void)
+{
+    return stub_time;
+}
+
+double clock_gettimesince(double prevsystime)
+{
+    return stub_time - prevsystime;
+}
+
+// ================================================================================ //
+//                                 ARRAYS, CANVASES                                 //
+// ================================================================================ //
+
+int garray_getfloatwords(t_garray* x, int* size, t_word** vec)
+{
+    *size = x->g_size;
+    *vec = x->g_vec;
+    return 1;
+}
+
+void garray_usedindsp(t_garray* x)
+{
+    ;
+}
+
+t_canvas* canvas_getcurrent(void)
+{
+    return NULL;
+}
+
+t_symbol* canvas_getdir(t_canvas* x)
+{
+    return gensym(".");
+}
+
+// ================================================================================ //
+//                                       HOST                                       //
+// ================================================================================ //
+
+void pdstub_setdsp(t_float sr, int blocksize)
+{
+    stub_sr = sr;
+    stub_blocksize = blocksize;
+}
+
+void pdstub_setverbose(int verbose)
+{
+    stub_verbose = verbose;
+}
+
+int pdstub_getnclasses(void)
+{
+    return stub_nclasses;
+}
+
+t_class* pdstub_getclass(int idx)
+{
+    return stub_classes[idx];
+}
+
+static t_method_entry* stub_findmethod(t_class* c, t_symbol* sel)
+{
+    int i = 0;
+    for(; i < c->c_nmethods; ++i)
+    {
+        if(c->c_methods[i].m_sel == sel) return &c->c_methods[i];
+    }
+    return NULL;
+}
+
+int pdstub_class_hasdsp(t_class* c)
+{
+    return stub_findmethod(c, gensym("dsp")) != NULL;
+}
+
+static int stub_parse(const char* text, t_atom* argv, int maxargs)
+{
+    int argc = 0;
+    char token[256];
+
+    while(text && *text && argc < maxargs)
+    {
+        while(*text == ' ' || *text == '\t') text++;
+        if(!*text) break;
+
+        int len = 0;
+        while(*text && *text != ' ' && *text != '\t' && len < 255)
+        {
+            token[len++] = *text++;
+        }
+        token[len] = '\0';
+
+        char* end = NULL;
+        const double value = strtod(token, &end);
+        if(end && *end == '\0')
+        {
+            argv[argc].a_type = A_FLOAT;
+            argv[argc].a_w.w_float = (t_float)value;
+        }
+        else
+        {
+            argv[argc].a_type = A_SYMBOL;
+            argv[argc].a_w.w_symbol = gensym(token);
+        }
+        argc++;
+    }
+
+    return argc;
+}
+
+// Pd passes the pointer arguments first, then the float arguments.
+typedef struct _callargs
+{
+    void*       p[PDSTUB_MAXARGS + 1];
+    int         np;
+    t_floatarg  f[PDSTUB_MAXARGS];
+    int         nf;
+} t_callargs;
+
+static int stub_fillargs(t_callargs* call, t_atomtype const* types, int ntypes, int argc, t_atom* argv)
+{
+    int i = 0;
+    for(; i < ntypes; ++i)
+    {
+        const t_atomtype type = types[i];
+        if(type == A_FLOAT || type == A_DEFFLOAT)
+        {
+            if(i < argc && argv[i].a_type == A_FLOAT) call->f[call->nf++] = argv[i].a_w.w_float;
+            else if(type == A_DEFFLOAT) call->f[call->nf++] = 0.f;
+            else return -1;
+        }
+        else if(type == A_SYMBOL || type == A_DEFSYM)
+        {
+            if(i < argc && argv[i].a_type == A_SYMBOL) call->p[call->np++] = argv[i].a_w.w_symbol;
+            else if(type == A_DEFSYM) call->p[call->np++] = &s_;
+            else return -1;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+typedef void* (*t_stubfn)();
+
+static void* stub_call(t_method fn, t_callargs* c)
+{
+    void** p = c->p;
+    t_floatarg* f = c->f;
+
+    switch(c->np * 10 + c->nf)
+    {
+        case 0:  return ((void*(*)(void))fn)();
+        case 1:  return ((void*(*)(t_floatarg))fn)(f[0]);
+        case 2:  return ((void*(*)(t_floatarg, t_floatarg))fn)(f[0], f[1]);
+        case 10: return ((void*(*)(void*))fn)(p[0]);
+        case 11: return ((void*(*)(void*, t_floatarg))fn)(p[0], f[0]);
+        case 12: return ((void*(*)(void*, t_floatarg, t_floatarg))fn)(p[0], f[0], f[1]);
+        case 13: return ((void*(*)(void*, t_floatarg, t_floatarg, t_floatarg))fn)(p[0], f[0], f[1], f[2]);
+        case 20: return ((void*(*)(void*, void*))fn)(p[0], p[1]);
+        case 21: return ((void*(*)(void*, void*, t_floatarg))fn)(p[0], p[1], f[0]);
+        case 22: return ((void*(*)(void*, void*, t_floatarg, t_floatarg))fn)(p[0], p[1], f[0], f[1]);
+        case 30: return ((void*(*)(void*, void*, void*))fn)(p[0], p[1], p[2]);
+        default: break;
+    }
+
+    error("pdstub: unsupported method signature");
+    return NULL;
+}
+
+t_object* pdstub_object_new(t_class* c, const char* args)
+{
+    t_atom argv[64];
+    const int argc = stub_parse(args, argv, 64);
+
+    if(c->c_nargs == 1 && c->c_args[0] == A_GIMME)
+    {
+        return (t_object*)((void*(*)(t_symbol*, int, t_atom*))c->c_new)(c->c_name, argc, argv);
+    }
+
+    t_callargs call;
+    call.np = call.nf = 0;
+    if(stub_fillargs(&call, c->c_args, c->c_nargs, argc, argv))
+    {
+        error("pdstub: %s: bad arguments", c->c_name->s_name);
+        return NULL;
+    }
+
+    return (t_object*)stub_call((t_method)c->c_new, &call);
+}
+
+void pdstub_object_free(t_object* x)
+{
+    t_class* c = x->ob_pd;
+    if(c->c_free)
+    {
+        ((void(*)(t_object*))c->c_free)(x);
+    }
+
+    int i = 0;
+    for(; i < stub_nclocks; ++i)
+    {
+        if(stub_clocks[i]->c_owner == x) stub_clocks[i]->c_set = 0;
+    }
+
+    for(i = 0; i < stub_niocounts; ++i)
+    {
+        if(stub_iocounts[i].x == x)
+        {
+            stub_iocounts[i] = stub_iocounts[--stub_niocounts];
+            break;
+        }
+    }
+
+    free(x);
+}
+
+int pdstub_object_send(t_object* x, const char* selector, const char* args)
+{
+    t_atom argv[1024];
+    const int argc = stub_parse(args, argv, 1024);
+    t_symbol* sel = gensym(selector);
+
+    t_method_entry* m = stub_findmethod(x->ob_pd, sel);
+    if(!m)
+    {
+        error("pdstub: %s: no method for '%s'", x->ob_pd->c_name->s_name, selector);
+        return -1;
+    }
+
+    if(m->m_nargs == 1 && m->m_args[0] == A_GIMME)
+    {
+        ((void(*)(t_object*, t_symbol*, int, t_atom*))m->m_fn)(x, sel, argc, argv);
+        return 0;
+    }
+
+    t_callargs call;
+    call.p[0] = x;
+    call.np = 1;
+    call.nf = 0;
+    if(stub_fillargs(&call, m->m_args, m->m_nargs, argc, argv))
+    {
+        error("pdstub: %s: bad arguments for '%s'", x->ob_pd->c_name->s_name, selector);
+        return -1;
+    }
+
+    stub_call(m->m_fn, &call);
+    return 0;
+}
+
+int pdstub_object_nsiginlets(t_object* x)
+{
+    return stub_getiocount(x)->nsigin + (x->ob_pd->c_mainsignalin >= 0 ? 1 : 0);
+}
+
+int pdstub_object_nsigoutlets(t_object* x)
+{
+    return stub_getiocount(x)->nsigout;
+}
+
+static void stub_clearchain(void)
+{
+    int i = 0;
+    for(; i < stub_nchain; ++i)
+    {
+        free(stub_chain[i]);
+    }
+    stub_nchain = 0;
+}
+
+void pdstub_dsp_begin(void)
+{
+    stub_clearchain();
+    stub_sortno++;
+}
+
+void pdstub_object_adddsp(t_object* x, t_signal** sp)
+{
+    t_method_entry* m = stub_findmethod(x->ob_pd, gensym("dsp"));
+    if(m)
+    {
+        ((void(*)(t_object*, t_signal**))m->m_fn)(x, sp);
+    }
+}
+
+void pdstub_object_dsp(t_object* x, t_signal** sp)
+{
+    pdstub_dsp_begin();
+    pdstub_object_adddsp(x, sp);
+}
+
+void pdstub_dsp_tick(void)
+{
+    // like the Pd scheduler, run the clocks that are due during this block
+    // then advance the logical time and compute the block.
+    const double next_time = stub_time + 1000. * stub_blocksize / stub_sr;
+
+    int i = 0;
+    for(; i < stub_nclocks; ++i)
+    {
+        t_clock* c = stub_clocks[i];
+        if(c->c_set && c->c_settime < next_time)
+        {
+            c->c_set = 0;
+            stub_time = c->c_settime;
+            ((void(*)(void*))c->c_fn)(c->c_owner);
+        }
+    }
+
+    stub_time = next_time;
+
+    for(i = 0; i < stub_nchain; ++i)
+    {
+        t_int* w = stub_chain[i];
+        ((t_perfroutine)w[0])(w);
+    }
+}
+
+int pdstub_dsp_nroutines(void)
+{
+    return stub_nchain;
+}
+
+void pdstub_array_new(const char* name, int size)
+{
+    stub_init();
+
+    t_garray* a = (t_garray*)pd_new(garray_class);
+    a->g_name = gensym(name);
+    a->g_size = size;
+    a->g_vec = (t_word*)calloc(size, sizeof(t_word));
+
+    int i = 0;
+    for(; i < size; ++i)
+    {
+        const double t = (double)i / size;
+        a->g_vec[i].w_float = (t_float)sin(2. * 3.14159265358979 * 100. * t * t);
+    }
+
+    pd_bind(&a->g_pd, a->g_name);
+}
@@ -0,0 +1,74 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+// Host side of the Pd stub: lets the benchmark create objects, send them messages,
+// build their dsp chain and run it.
+
+#ifndef __pdstub_h_
+#define __pdstub_h_
+
+#include "m_pd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! @brief Set the sampling rate and block size returned by sys_getsr() and sys_getblksize().
+void pdstub_setdsp(t_float sr, int blocksize);
+
+//! @brief Print the post() messages (they are discarded by default).
+void pdstub_setverbose(int verbose);
+
+//! @brief Returns the number of classes created by the setup methods.
+int pdstub_getnclasses(void);
+
+//! @brief Returns a class created by a setup method.
+t_class* pdstub_getclass(int idx);
+
+//! @brief Returns 1 if the class has a "dsp" method.
+int pdstub_class_hasdsp(t_class* c);
+
+//! @brief Create a new object, args is parsed like the content of a Pd object box.
+t_object* pdstub_object_new(t_class* c, const char* args);
+
+//! @brief Free an object created by pdstub_object_new().
+void pdstub_object_free(t_object* x);
+
+//! @brief Send a message to an object, args is parsed like the content of a Pd message box.
+//! @return 0 if the object has a method for this selector.
+int pdstub_object_send(t_object* x, const char* selector, const char* args);
+
+//! @brief Returns the number of signal inlets of an object.
+int pdstub_object_nsiginlets(t_object* x);
+
+//! @brief Returns the number of signal outlets of an object.
+int pdstub_object_nsigoutlets(t_object* x);
+
+//! @brief Clear the dsp chain, then call the "dsp" method of an object with the given signals.
+//! @details The signal inlets come first, then the signal outlets.
+void pdstub_object_dsp(t_object* x, t_signal** sp);
+
+//! @brief Clear the dsp chain and start a new dsp build (see ugen_getsortno()).
+void pdstub_dsp_begin(void);
+
+//! @brief Call the "dsp" method of an object without clearing the dsp chain.
+//! @details Used to run several objects in the same dsp build, in the order of the calls.
+void pdstub_object_adddsp(t_object* x, t_signal** sp);
+
+//! @brief Run the dsp chain once (one block).
+void pdstub_dsp_tick(void);
+
+//! @brief Returns the number of perform routines in the dsp chain.
+int pdstub_dsp_nroutines(void);
+
+//! @brief Create a named array of the given size (filled with a sine sweep).
+void pdstub_array_new(const char* name, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __pdstub_h_
@@ -0,0 +1,154 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief The Pd array read by the readbuffer objects.
+//! @details The array is resolved when its name is set and each time the dsp chain is built.
+//! garray_usedindsp() makes Pd rebuild the dsp chain when the array is resized or deleted,
+//! so the samples stay valid between two dsp builds and the perform routines only check
+//! once per block whether there is an array to read (see pa_array_isvalid()).
+//! If there is no array with this name, the samples of a pa.mmapsource object are read instead
+//! (see pa_mmapsource.h). The samples are reached through a pointer and a stride, so that
+//! the words of an array and the interleaved channels of a mapped file are read the same way.
+
+#ifndef PA_ARRAY_H
+#define PA_ARRAY_H
+
+#include <m_pd.h>
+
+#include "pa_mmapsource.h"
+
+//! @brief The stride of the samples of a Pd array (the float of each t_word).
+#define PA_ARRAY_WORD_STRIDE ((int)(sizeof(t_word) / sizeof(t_float)))
+
+//! @brief The result of the last resolution, an error is only posted when it changes.
+typedef enum _pa_array_state
+{
+    PA_ARRAY_UNSET = 0,     // no name
+    PA_ARRAY_VALID,
+    PA_ARRAY_NOT_FOUND,
+    PA_ARRAY_BAD_TEMPLATE,
+    PA_ARRAY_NO_FILE,       // a pa.mmapsource without file
+    PA_ARRAY_NO_CHANNEL     // a pa.mmapsource without the channel of m_offset
+
+} t_pa_array_state;
+
+typedef struct _pa_array
+{
+    t_symbol*           m_name;
+    t_float const*      m_samples;  // the sample i is m_samples[i * m_stride]
+    int                 m_stride;
+    int                 m_size;
+    int                 m_state;
+    t_pa_mmapsource*    m_source;   // the source of the samples if they are mapped from a file
+    int                 m_offset;   // channel read from a source, relative to its selected channel (0 by default)
+
+} t_pa_array;
+
+//! @brief Find the array again and update its samples.
+//! @details Call it from the dsp method. Errors are reported by owner, once until the state changes.
+//! @return 0 if there is an array to read, -1 otherwise.
+static inline int pa_array_update(t_pa_array* a, void* owner, const char* objname)
+{
+    t_garray* garray = NULL;
+    t_pa_mmapsource* source = NULL;
+    t_word* vec = NULL;
+    int state = PA_ARRAY_UNSET;
+
+    a->m_samples = NULL;
+    a->m_stride = PA_ARRAY_WORD_STRIDE;
+    a->m_size = 0;
+    a->m_source = NULL;
+
+    if(a->m_name && a->m_name != &s_)
+    {
+        garray = (t_garray*)pd_findbyclass(a->m_name, garray_class);
+
+        if(garray)
+        {
+            if(!garray_getfloatwords(garray, &a->m_size, &vec))
+            {
+                a->m_size = 0;
+                state = PA_ARRAY_BAD_TEMPLATE;
+            }
+            else
+            {
+                // mark the array as used by the DSP
+                // doing so will cause the dsp chain to be rebuilt when the array is resized or removed
+                garray_usedindsp(garray);
+                a->m_samples = &vec->w_float;
+                state = PA_ARRAY_VALID;
+            }
+        }
+        else if((source = pa_mmapsource_find(a->m_name)) != NULL)
+        {
+            if(source->m_samples && source->m_channel + a->m_offset >= source->m_channels)
+            {
+                // the channel may exist when the source selects another one
+                source->m_usedindsp = 1;
+                state = PA_ARRAY_NO_CHANNEL;
+            }
+            else if(source->m_samples && source->m_frames > 0)
+            {
+                // the source rebuilds the dsp chain when its file is closed or changed
+                source->m_usedindsp = 1;
+                a->m_samples = source->m_samples + a->m_offset;
+                a->m_stride = source->m_channels;
+                a->m_size = source->m_frames;
+                a->m_source = source;
+                state = PA_ARRAY_VALID;
+            }
+            else
+            {
+                state = PA_ARRAY_NO_FILE;
+            }
+        }
+        else
+        {
+            state = PA_ARRAY_NOT_FOUND;
+        }
+    }
+
+    if(state != a->m_state)
+    {
+        if(state == PA_ARRAY_NOT_FOUND)
+        {
+            pd_error(owner, "%s: %s no such array.", objname, a->m_name->s_name);
+        }
+        else if(state == PA_ARRAY_BAD_TEMPLATE)
+        {
+            pd_error(owner, "%s: %s bad template.", objname, a->m_name->s_name);
+        }
+        else if(state == PA_ARRAY_NO_FILE)
+        {
+            pd_error(owner, "%s: %s no file opened.", objname, a->m_name->s_name);
+        }
+        else if(state == PA_ARRAY_NO_CHANNEL)
+        {
+            pd_error(owner, "%s: %s no channel %d.", objname, a->m_name->s_name, a->m_offset + 1 + (source ? source->m_channel : 0));
+        }
+
+        a->m_state = state;
+    }
+
+    return (state == PA_ARRAY_VALID) ? 0 : -1;
+}
+
+//! @brief Set the name of the array and find it.
+//! @return 0 if there is an array to read, -1 otherwise.
+static inline int pa_array_set(t_pa_array* a, t_symbol* name, void* owner, const char* objname)
+{
+    a->m_name = name;
+    a->m_state = PA_ARRAY_UNSET;
+    return pa_array_update(a, owner, objname);
+}
+
+//! @brief Returns 1 if there are samples to read.
+static inline int pa_array_isvalid(t_pa_array const* a)
+{
+    return a->m_samples && a->m_size > 0;
+}
+
+#endif // PA_ARRAY_H
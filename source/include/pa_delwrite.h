@@ -0,0 +1,58 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief The named delay line shared by pa.delwrite~ and pa.delread~.
+//! @details pa.delwrite~ binds itself to its name, pa.delread~ finds it with this name
+//! each time the dsp chain is built. The two objects are compiled as separate externals,
+//! so the reader can't use the class pointer of the writer: it checks the class name instead.
+
+#ifndef PA_DELWRITE_H
+#define PA_DELWRITE_H
+
+#include <m_pd.h>
+#include <string.h> // strcmp
+
+#include "pa_ringbuffer_resizer.h"
+
+#define PA_DELWRITE_CLASS_NAME "pa.delwrite~"
+
+typedef struct _pa_delwrite_tilde
+{
+    t_object        m_obj;
+
+    t_symbol*       m_name;
+    t_pa_ringbuffer m_buffer;
+    t_pa_ringbuffer_resizer m_resizer;  // resizes m_buffer while the dsp runs (see maxdelay)
+    int             m_vecsize;  // block size of the last dsp build
+    int             m_sortno;   // sort number of the last dsp build (see ugen_getsortno())
+
+    float           m_f;
+
+} t_pa_delwrite_tilde;
+
+//! @brief Returns the pa.delwrite~ object bound to a name or NULL.
+//! @details Also returns NULL if several objects are bound to this name.
+static inline t_pa_delwrite_tilde* pa_delwrite_tilde_find(t_symbol* name)
+{
+    t_pd* x = name ? name->s_thing : NULL;
+
+    if(x && strcmp(class_getname(*x), PA_DELWRITE_CLASS_NAME) == 0)
+    {
+        return (t_pa_delwrite_tilde*)x;
+    }
+
+    return NULL;
+}
+
+//! @brief Returns 1 if the dsp method of the writer has already been called in the current dsp build.
+//! @details In this case the writer has written the current block when a reader reads it,
+//! otherwise the reader runs first and can't read less than one block of delay.
+static inline int pa_delwrite_tilde_is_sorted_first(t_pa_delwrite_tilde const* x)
+{
+    return x->m_sortno == ugen_getsortno();
+}
+
+#endif // PA_DELWRITE_H
@@ -0,0 +1,76 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief The sound file mapped in memory by pa.mmapsource and read by the readbuffer objects.
+//! @details pa.mmapsource maps a file of 32-bit float samples read-only and binds itself to its name,
+//! the readbuffer objects then read the samples where they are mapped instead of a Pd array (see pa_array.h).
+//! Nothing is copied: the pages are read from the disk when they are first touched and stay in the
+//! page cache, where they are shared by all the processes that map the same file.
+//! Like pa_delwrite.h, the readers check the class name since the objects are separate externals.
+
+#ifndef PA_MMAPSOURCE_H
+#define PA_MMAPSOURCE_H
+
+#include <m_pd.h>
+#include <stddef.h> // size_t
+#include <string.h> // strcmp
+
+#define PA_MMAPSOURCE_CLASS_NAME "pa.mmapsource"
+
+typedef struct _pa_mmapsource
+{
+    t_object        m_obj;
+
+    t_symbol*       m_name;
+    t_symbol*       m_dir;          // the directory of the patch, relative paths start from it
+
+    // the mapped file
+    void*           m_map;
+    size_t          m_mapsize;
+
+    // the samples of the selected channel, they are interleaved with the other channels
+    t_float const*  m_samples;
+    int             m_frames;
+    int             m_channels;
+    int             m_channel;
+
+    // a reader uses the samples, the dsp chain must be rebuilt when they change (like garray_usedindsp())
+    int             m_usedindsp;
+
+    // prefetch: the range of frames read by the readers since the last prefetch
+    int             m_prefetch;     // number of frames prefetched around the readers, 0 to disable
+    int             m_hint_first;
+    int             m_hint_last;
+    t_clock*        m_clock;
+
+} t_pa_mmapsource;
+
+//! @brief Returns the pa.mmapsource object bound to a name or NULL.
+//! @details Also returns NULL if several objects are bound to this name.
+static inline t_pa_mmapsource* pa_mmapsource_find(t_symbol* name)
+{
+    t_pd* x = name ? name->s_thing : NULL;
+
+    if(x && strcmp(class_getname(*x), PA_MMAPSOURCE_CLASS_NAME) == 0)
+    {
+        return (t_pa_mmapsource*)x;
+    }
+
+    return NULL;
+}
+
+//! @brief Let the source know that a reader is playing around a frame, called once per block.
+//! @details The source prefetches the pages around these frames from its clock, not from the audio thread.
+static inline void pa_mmapsource_hint(t_pa_mmapsource* x, int frame)
+{
+    if(x->m_prefetch > 0)
+    {
+        if(frame < x->m_hint_first) x->m_hint_first = frame;
+        if(frame > x->m_hint_last) x->m_hint_last = frame;
+    }
+}
+
+#endif // PA_MMAPSOURCE_H
@@ -0,0 +1,570 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A circular buffer shared by the delay objects.
+//! @details The allocated size is rounded up to a power of two,
+//! so positions are wrapped with a bitmask instead of compare-and-branch or while loops.
+//! A negative position is also wrapped correctly (two's complement).
+//! The first PA_RINGBUFFER_GUARD samples are mirrored after the end of the buffer
+//! (like the extra sample of the osc3 cosine table), so that the neighbours of a wrapped
+//! position can be read without wrapping them again, see pa_ringbuffer_get_frame().
+//! The samples of long buffers are mapped from the system instead of calloc'ed
+//! (see PA_RINGBUFFER_MMAP_SIZE): the pages are zeroed lazily when they are first touched,
+//! so the creation time doesn't depend on the size and the untouched regions cost no memory.
+
+#ifndef PA_RINGBUFFER_H
+#define PA_RINGBUFFER_H
+
+#include <stdlib.h> // calloc, free...
+#include <string.h> // memset
+
+#if defined(_WIN32)
+#include <windows.h> // VirtualAlloc, VirtualFree
+#else
+#include <sys/mman.h> // mmap, munmap, madvise
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+// lets the compiler know that block pointers don't overlap
+#if defined(_MSC_VER)
+#define PA_RESTRICT __restrict
+#elif defined(__GNUC__) || defined(__clang__)
+#define PA_RESTRICT __restrict__
+#else
+#define PA_RESTRICT
+#endif
+
+// number of samples mirrored after the end of the buffer
+#define PA_RINGBUFFER_GUARD 4
+
+// allocated size (in samples) from which the samples are mapped from the system, 0 to always use calloc
+#ifndef PA_RINGBUFFER_MMAP_SIZE
+#define PA_RINGBUFFER_MMAP_SIZE (1 << 20)
+#endif
+
+typedef struct _pa_ringbuffer
+{
+    float*  m_buffer;       // allocated samples (m_allocsize + PA_RINGBUFFER_GUARD)
+    int     m_size;         // usable size (maximum delay in samples)
+    int     m_allocsize;    // allocated size (m_size rounded up to a power of two)
+    int     m_mask;         // m_allocsize - 1
+    int     m_writer;       // position of the next sample to write
+    int     m_filled;       // number of samples written since the buffer was zeroed (at most m_allocsize)
+    int     m_mapped;       // 1 if the samples are mapped from the system (see pa_ringbuffer_alloc_samples())
+
+} t_pa_ringbuffer;
+
+// maximum number of samples of a ringbuffer, headroom included (its allocated size must fit in an int)
+#define PA_RINGBUFFER_MAX_SIZE (1 << 30)
+
+//! @brief Returns the smallest power of two greater or equal to size.
+//! @details size must not be greater than PA_RINGBUFFER_MAX_SIZE.
+static inline size_t pa_ringbuffer_nextpow2(size_t size)
+{
+    size_t pow2 = 1;
+    while(pow2 < size) pow2 <<= 1;
+    return pow2;
+}
+
+//! @brief Returns 1 if a number of samples given by the user can be the size of a ringbuffer.
+//! @details Check the float arguments with it before casting them to int (NaN isn't valid).
+static inline int pa_ringbuffer_isvalidsize(double size)
+{
+    return (size >= 1. && size <= (double)PA_RINGBUFFER_MAX_SIZE);
+}
+
+//! @brief Allocate allocsize + PA_RINGBUFFER_GUARD zeroed samples.
+//! @details Large buffers are mapped from the system with lazy zero pages (and transparent huge pages
+//! when available), mapped is then set to 1 and the samples must be freed with pa_ringbuffer_free_samples().
+//! @return The samples or NULL if the allocation failed.
+static inline float* pa_ringbuffer_alloc_samples(int allocsize, int* mapped)
+{
+    const size_t bytes = sizeof(float) * (size_t)(allocsize + PA_RINGBUFFER_GUARD);
+    float* samples = NULL;
+
+    *mapped = 0;
+
+    if(PA_RINGBUFFER_MMAP_SIZE > 0 && allocsize >= PA_RINGBUFFER_MMAP_SIZE)
+    {
+#if defined(_WIN32)
+        samples = (float*)VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(MAP_ANONYMOUS)
+        void* pages = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        samples = (pages != MAP_FAILED) ? (float*)pages : NULL;
+#if defined(MADV_HUGEPAGE)
+        if(samples) madvise(pages, bytes, MADV_HUGEPAGE);
+#endif
+#endif
+        if(samples)
+        {
+            *mapped = 1;
+            return samples;
+        }
+    }
+
+    return (float*)calloc(allocsize + PA_RINGBUFFER_GUARD, sizeof(float));
+}
+
+//! @brief Free samples allocated by pa_ringbuffer_alloc_samples().
+static inline void pa_ringbuffer_free_samples(float* samples, int allocsize, int mapped)
+{
+    if(!samples) return;
+
+    if(mapped)
+    {
+#if defined(_WIN32)
+        VirtualFree(samples, 0, MEM_RELEASE);
+#else
+        munmap(samples, sizeof(float) * (size_t)(allocsize + PA_RINGBUFFER_GUARD));
+#endif
+    }
+    else
+    {
+        free(samples);
+    }
+}
+
+//! @brief Free the samples of a ringbuffer.
+static inline void pa_ringbuffer_free(t_pa_ringbuffer* rb)
+{
+    if(rb->m_buffer)
+    {
+        pa_ringbuffer_free_samples(rb->m_buffer, rb->m_allocsize, rb->m_mapped);
+        rb->m_buffer = NULL;
+    }
+
+    rb->m_mapped = 0;
+    rb->m_size = rb->m_allocsize = 0;
+    rb->m_mask = 0;
+    rb->m_writer = 0;
+    rb->m_filled = 0;
+}
+
+//! @brief Allocate a zeroed ringbuffer that can hold size samples of history, with headroom samples after it.
+//! @details Pass the block size (and the samples read past the usable size) as headroom, so that the
+//! dsp method doesn't need to grow the buffer with pa_ringbuffer_reserve().
+//! @return 0 on success, -1 if the allocation failed or if size + headroom is greater than PA_RINGBUFFER_MAX_SIZE
+//! (the ringbuffer is then empty).
+static inline int pa_ringbuffer_init_headroom(t_pa_ringbuffer* rb, int size, int headroom)
+{
+    rb->m_buffer = NULL;
+    pa_ringbuffer_free(rb);
+
+    if(size < 1) size = 1;
+    if(headroom < 0) headroom = 0;
+
+    const size_t total = (size_t)size + (size_t)headroom;
+    if(total > PA_RINGBUFFER_MAX_SIZE) return -1;
+
+    const int allocsize = (int)pa_ringbuffer_nextpow2(total);
+    rb->m_buffer = pa_ringbuffer_alloc_samples(allocsize, &rb->m_mapped);
+
+    if(!rb->m_buffer)
+    {
+        return -1;
+    }
+
+    rb->m_size = size;
+    rb->m_allocsize = allocsize;
+    rb->m_mask = allocsize - 1;
+    return 0;
+}
+
+//! @brief Allocate a zeroed ringbuffer that can hold size samples of history.
+//! @return 0 on success, -1 if the allocation failed or if size is greater than PA_RINGBUFFER_MAX_SIZE
+//! (the ringbuffer is then empty).
+static inline int pa_ringbuffer_init(t_pa_ringbuffer* rb, int size)
+{
+    return pa_ringbuffer_init_headroom(rb, size, 0);
+}
+
+//! @brief Move the samples to a new allocation of a given size (a power of two), the most recent history is kept.
+//! @details Only the last history samples written before the writer are copied (at most the written
+//! and allocated sizes): the older ones can't be read, the new buffer is zeroed and the pages of a mapped
+//! buffer that were never written are left untouched.
+//! @return 0 on success, -1 if the allocation failed (the ringbuffer is then unchanged).
+static inline int pa_ringbuffer_realloc(t_pa_ringbuffer* rb, int allocsize, int history)
+{
+    int mapped = 0;
+    float* buffer = pa_ringbuffer_alloc_samples(allocsize, &mapped);
+
+    if(!buffer)
+    {
+        return -1;
+    }
+
+    // unwrap the most recent history at the start of the new buffer, oldest sample first.
+    int count = 0;
+    if(rb->m_buffer)
+    {
+        count = (history < rb->m_filled) ? history : rb->m_filled;
+        if(count > allocsize) count = allocsize;
+        if(count < 0) count = 0;
+
+        const int reader = (rb->m_writer - count) & rb->m_mask;
+        const int first = (count < rb->m_allocsize - reader) ? count : (rb->m_allocsize - reader);
+
+        memcpy(buffer, rb->m_buffer + reader, sizeof(float) * first);
+        memcpy(buffer + first, rb->m_buffer, sizeof(float) * (count - first));
+        memcpy(buffer + allocsize, buffer, sizeof(float) * PA_RINGBUFFER_GUARD);
+        pa_ringbuffer_free_samples(rb->m_buffer, rb->m_allocsize, rb->m_mapped);
+    }
+
+    rb->m_buffer = buffer;
+    rb->m_mapped = mapped;
+    rb->m_allocsize = allocsize;
+    rb->m_mask = allocsize - 1;
+    rb->m_writer = count & rb->m_mask;
+    rb->m_filled = count;
+    return 0;
+}
+
+//! @brief Make sure that at least size samples are allocated, the history is kept.
+//! @details Call this from the dsp method with m_size + the block size to let the block
+//! functions write a whole block before reading it. The usable size (m_size) is unchanged.
+//! Only the samples that can be read (m_size and the guard) are copied if the buffer grows.
+//! @return 0 on success, -1 if the allocation failed or if size is greater than PA_RINGBUFFER_MAX_SIZE
+//! (the ringbuffer is then unchanged).
+static inline int pa_ringbuffer_reserve(t_pa_ringbuffer* rb, int size)
+{
+    if(size > PA_RINGBUFFER_MAX_SIZE) return -1;
+
+    const int allocsize = (int)pa_ringbuffer_nextpow2((size_t)(size > 1 ? size : 1));
+
+    if(allocsize <= rb->m_allocsize)
+    {
+        return 0;
+    }
+
+    return pa_ringbuffer_realloc(rb, allocsize, rb->m_size + PA_RINGBUFFER_GUARD);
+}
+
+//! @brief Change the usable size, the most recent history is kept.
+//! @details headroom samples are allocated after the usable size (see pa_ringbuffer_reserve()).
+//! The allocation shrinks if the new size needs less than half of it.
+//! The samples are allocated and copied by the calling thread, which can take a while for long buffers:
+//! see pa_ringbuffer_resizer.h to resize the buffers of a running dsp chain.
+//! @return 0 on success, -1 if the allocation failed or if size + headroom is greater than PA_RINGBUFFER_MAX_SIZE
+//! (the ringbuffer is then unchanged).
+static inline int pa_ringbuffer_resize(t_pa_ringbuffer* rb, int size, int headroom)
+{
+    if(size < 1) size = 1;
+    if(headroom < 0) headroom = 0;
+
+    const size_t total = (size_t)size + (size_t)headroom;
+    if(total > PA_RINGBUFFER_MAX_SIZE) return -1;
+
+    const int allocsize = (int)pa_ringbuffer_nextpow2(total);
+
+    if(allocsize != rb->m_allocsize && pa_ringbuffer_realloc(rb, allocsize, rb->m_size + headroom))
+    {
+        return -1;
+    }
+
+    rb->m_size = size;
+    return 0;
+}
+
+//! @brief Set all samples to zero.
+//! @details On Linux, the pages of a mapped buffer are given back to the system instead,
+//! they are zeroed again when they are touched.
+static inline void pa_ringbuffer_clear(t_pa_ringbuffer* rb)
+{
+    rb->m_filled = 0;
+
+    if(rb->m_buffer)
+    {
+        const size_t bytes = sizeof(float) * (size_t)(rb->m_allocsize + PA_RINGBUFFER_GUARD);
+#if defined(__linux__) && defined(MADV_DONTNEED)
+        if(rb->m_mapped && madvise(rb->m_buffer, bytes, MADV_DONTNEED) == 0)
+        {
+            return;
+        }
+#endif
+        memset(rb->m_buffer, 0, bytes);
+    }
+}
+
+//! @brief Wrap a position between the buffer boundaries.
+static inline int pa_ringbuffer_wrap(t_pa_ringbuffer const* rb, int idx)
+{
+    return idx & rb->m_mask;
+}
+
+//! @brief Returns the sample at a given position (wrapped).
+static inline float pa_ringbuffer_get(t_pa_ringbuffer const* rb, int idx)
+{
+    return rb->m_buffer[idx & rb->m_mask];
+}
+
+//! @brief Returns the address of the sample at a given position (wrapped).
+//! @details The PA_RINGBUFFER_GUARD - 1 following samples can be read from this address
+//! without wrapping, for instance the two points of a linear interpolation.
+static inline float const* pa_ringbuffer_get_frame(t_pa_ringbuffer const* rb, int idx)
+{
+    return rb->m_buffer + (idx & rb->m_mask);
+}
+
+//! @brief Returns the sample written delay samples before the next one to write.
+//! @details delay must be in the [1, m_size] range.
+static inline float pa_ringbuffer_read(t_pa_ringbuffer const* rb, int delay)
+{
+    return rb->m_buffer[(rb->m_writer - delay) & rb->m_mask];
+}
+
+//! @brief Write a sample and move the writer forward.
+static inline void pa_ringbuffer_write(t_pa_ringbuffer* rb, float sample)
+{
+    rb->m_buffer[rb->m_writer] = sample;
+
+    if(rb->m_filled < rb->m_allocsize)
+    {
+        rb->m_filled++;
+    }
+
+    // keep the guard in sync
+    if(rb->m_writer < PA_RINGBUFFER_GUARD)
+    {
+        rb->m_buffer[rb->m_allocsize + rb->m_writer] = sample;
+    }
+
+    rb->m_writer = (rb->m_writer + 1) & rb->m_mask;
+}
+
+//! @brief Returns 1 if a whole block of n samples can be written before reading it with a given delay.
+static inline int pa_ringbuffer_can_process_block(t_pa_ringbuffer const* rb, int delay, int n)
+{
+    return (delay + n <= rb->m_allocsize);
+}
+
+//! @brief Write a block of samples and move the writer forward.
+//! @details Copies at most two contiguous segments.
+static inline void pa_ringbuffer_write_block(t_pa_ringbuffer* rb, float const* in, int n)
+{
+    const int first = (n < rb->m_allocsize - rb->m_writer) ? n : (rb->m_allocsize - rb->m_writer);
+
+    memcpy(rb->m_buffer + rb->m_writer, in, sizeof(float) * first);
+    memcpy(rb->m_buffer, in + first, sizeof(float) * (n - first));
+
+    // keep the guard in sync (cheaper than checking if the block wrote the first samples)
+    memcpy(rb->m_buffer + rb->m_allocsize, rb->m_buffer, sizeof(float) * PA_RINGBUFFER_GUARD);
+
+    rb->m_writer = (rb->m_writer + n) & rb->m_mask;
+    rb->m_filled = (n < rb->m_allocsize - rb->m_filled) ? (rb->m_filled + n) : rb->m_allocsize;
+}
+
+//! @brief Read the n samples written delay samples before the last n written samples.
+//! @details Use it after pa_ringbuffer_write_block(), out may be the written block.
+//! Copies at most two contiguous segments, see pa_ringbuffer_can_process_block().
+static inline void pa_ringbuffer_read_block(t_pa_ringbuffer const* rb, int delay, float* out, int n)
+{
+    const int reader = (rb->m_writer - n - delay) & rb->m_mask;
+    const int first = (n < rb->m_allocsize - reader) ? n : (rb->m_allocsize - reader);
+
+    memcpy(out, rb->m_buffer + reader, sizeof(float) * first);
+    memcpy(out + first, rb->m_buffer, sizeof(float) * (n - first));
+}
+
+//! @brief Copy a block of delays (in samples) and clip them between mindelay and m_size - 1 samples.
+//! @details Clipping in a separate pass keeps the reading loops free of branches.
+//! in and out must not overlap.
+static inline void pa_ringbuffer_clip_delays_range(t_pa_ringbuffer const* rb, float mindelay,
+                                                   float const* PA_RESTRICT in, float* PA_RESTRICT out, int n)
+{
+    const float maxdelay = (float)rb->m_size;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        float delay = in[i];
+        delay = (delay >= maxdelay) ? (maxdelay - 1.f) : delay;
+        delay = (delay < mindelay) ? mindelay : delay;
+        out[i] = delay;
+    }
+}
+
+//! @brief Copy a block of delays (in samples) and clip them between 1 and m_size - 1 samples.
+//! @details See pa_ringbuffer_clip_delays_range().
+static inline void pa_ringbuffer_clip_delays(t_pa_ringbuffer const* rb, float const* in, float* out, int n)
+{
+    pa_ringbuffer_clip_delays_range(rb, 1.f, in, out, n);
+}
+
+//! @brief Read a block with linear interpolation, with one (fractional) delay per sample.
+//! @details Use it after pa_ringbuffer_write_block(), out[i] is the sample written delays[i]
+//! samples before the i-th sample of the last written block.
+//! Delays must be clipped (see pa_ringbuffer_clip_delays()) and a block of headroom is needed
+//! (see pa_ringbuffer_can_process_block()). There is no branch and no wrapping loop
+//! so the compiler can vectorize this loop, out must not overlap delays or the buffer.
+static inline void pa_ringbuffer_read_linear_block(t_pa_ringbuffer const* rb, float const* PA_RESTRICT delays,
+                                                   float* PA_RESTRICT out, int n)
+{
+    float const* PA_RESTRICT buffer = rb->m_buffer;
+    const int mask = rb->m_mask;
+    const int start = rb->m_writer - n;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const float delay = delays[i];
+        const int idelay = (int)delay;
+        const float delta = delay - (float)idelay;
+        const int base = (start + i - idelay - 1) & mask;
+
+        // the guard lets us read both points from the wrapped position of the oldest one
+        const float y2 = buffer[base];
+        const float y1 = buffer[base + 1];
+        out[i] = y1 + delta * (y2 - y1);
+    }
+}
+
+//! @brief Read a block with cubic Hermite (Catmull-Rom) interpolation, see pa_ringbuffer_read_linear_block().
+//! @details Reads one sample older than the linear interpolation, the headroom must be one sample bigger.
+static inline void pa_ringbuffer_read_hermite_block(t_pa_ringbuffer const* rb, float const* PA_RESTRICT delays,
+                                                    float* PA_RESTRICT out, int n)
+{
+    float const* PA_RESTRICT buffer = rb->m_buffer;
+    const int mask = rb->m_mask;
+    const int start = rb->m_writer - n;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const float delay = delays[i];
+        const int idelay = (int)delay;
+        const int base = (start + i - idelay - 2) & mask;
+
+        // 4 points from the oldest one, t is the position between x0 and x1
+        const float xm1 = buffer[base];
+        const float x0 = buffer[base + 1];
+        const float x1 = buffer[base + 2];
+        const float x2 = buffer[base + 3];
+        const float t = 1.f - (delay - (float)idelay);
+
+        const float c1 = 0.5f * (x1 - xm1);
+        const float c2 = xm1 - 2.5f * x0 + 2.f * x1 - 0.5f * x2;
+        const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+        out[i] = ((c3 * t + c2) * t + c1) * t + x0;
+    }
+}
+
+//! @brief Read a block with 4-point (third-order) Lagrange interpolation, see pa_ringbuffer_read_hermite_block().
+static inline void pa_ringbuffer_read_lagrange_block(t_pa_ringbuffer const* rb, float const* PA_RESTRICT delays,
+                                                     float* PA_RESTRICT out, int n)
+{
+    float const* PA_RESTRICT buffer = rb->m_buffer;
+    const int mask = rb->m_mask;
+    const int start = rb->m_writer - n;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const float delay = delays[i];
+        const int idelay = (int)delay;
+        const int base = (start + i - idelay - 2) & mask;
+
+        const float xm1 = buffer[base];
+        const float x0 = buffer[base + 1];
+        const float x1 = buffer[base + 2];
+        const float x2 = buffer[base + 3];
+        const float t = 1.f - (delay - (float)idelay);
+
+        // Lagrange polynomials of the points at -1, 0, 1 and 2
+        const float tp1 = t + 1.f;
+        const float tm1 = t - 1.f;
+        const float tm2 = t - 2.f;
+        out[i] = (xm1 * (-t * tm1 * tm2) + x2 * (tp1 * t * tm1)) * (1.f / 6.f)
+               + (x0 * (tp1 * tm1 * tm2) - x1 * (tp1 * t * tm2)) * 0.5f;
+    }
+}
+
+//! @brief Read a block with first-order allpass interpolation, see pa_ringbuffer_read_linear_block().
+//! @details The allpass filter has a flat magnitude response but is recursive:
+//! state holds the last output and must be kept between blocks (one per reader),
+//! so this loop can't be vectorized. Fractional parts under 0.1 are read as 1 + fraction
+//! from one sample later, to keep the pole of the filter away from -1.
+static inline void pa_ringbuffer_read_allpass_block(t_pa_ringbuffer const* rb, float const* PA_RESTRICT delays,
+                                                    float* PA_RESTRICT out, int n, float* state)
+{
+    float const* PA_RESTRICT buffer = rb->m_buffer;
+    const int mask = rb->m_mask;
+    const int start = rb->m_writer - n;
+    float last = *state;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const float delay = delays[i];
+        int idelay = (int)delay;
+        float delta = delay - (float)idelay;
+
+        if(delta < 0.1f && idelay > 1)
+        {
+            idelay--;
+            delta += 1.f;
+        }
+
+        const int base = (start + i - idelay - 1) & mask;
+        const float eta = (1.f - delta) / (1.f + delta);
+
+        last = buffer[base] + eta * (buffer[base + 1] - last);
+        out[i] = last;
+    }
+
+    *state = last;
+}
+
+//! @brief The interpolation modes of the block reading functions.
+typedef enum _pa_ringbuffer_interp
+{
+    PA_RINGBUFFER_INTERP_LINEAR = 0,
+    PA_RINGBUFFER_INTERP_HERMITE,
+    PA_RINGBUFFER_INTERP_LAGRANGE,
+    PA_RINGBUFFER_INTERP_ALLPASS
+
+} t_pa_ringbuffer_interp;
+
+//! @brief Returns the interpolation mode of a given name ("linear", "hermite", "lagrange" or "allpass").
+//! @return The interpolation mode or -1 if the name is unknown.
+static inline int pa_ringbuffer_interp_from_name(const char* name)
+{
+    if(strcmp(name, "linear") == 0) return PA_RINGBUFFER_INTERP_LINEAR;
+    if(strcmp(name, "hermite") == 0) return PA_RINGBUFFER_INTERP_HERMITE;
+    if(strcmp(name, "lagrange") == 0) return PA_RINGBUFFER_INTERP_LAGRANGE;
+    if(strcmp(name, "allpass") == 0) return PA_RINGBUFFER_INTERP_ALLPASS;
+    return -1;
+}
+
+//! @brief Returns the name of an interpolation mode.
+static inline const char* pa_ringbuffer_interp_name(int mode)
+{
+    switch(mode)
+    {
+        case PA_RINGBUFFER_INTERP_HERMITE:  return "hermite";
+        case PA_RINGBUFFER_INTERP_LAGRANGE: return "lagrange";
+        case PA_RINGBUFFER_INTERP_ALLPASS:  return "allpass";
+        default:                            return "linear";
+    }
+}
+
+//! @brief Read a block with a given interpolation mode.
+//! @details The headroom must be one block and one sample (see pa_ringbuffer_can_process_block()),
+//! state is only used by the allpass interpolation.
+static inline void pa_ringbuffer_read_interp_block(t_pa_ringbuffer const* rb, int mode, float const* delays,
+                                                   float* out, int n, float* state)
+{
+    switch(mode)
+    {
+        case PA_RINGBUFFER_INTERP_HERMITE:  pa_ringbuffer_read_hermite_block(rb, delays, out, n); break;
+        case PA_RINGBUFFER_INTERP_LAGRANGE: pa_ringbuffer_read_lagrange_block(rb, delays, out, n); break;
+        case PA_RINGBUFFER_INTERP_ALLPASS:  pa_ringbuffer_read_allpass_block(rb, delays, out, n, state); break;
+        default:                            pa_ringbuffer_read_linear_block(rb, delays, out, n); break;
+    }
+}
+
+#endif // PA_RINGBUFFER_H
@@ -0,0 +1,463 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Resizes ringbuffers without allocating, copying or freeing samples on the audio thread.
+//! @details A resize goes through three steps:
+//! - pa_ringbuffer_resizer_request() (from a method) allocates the new buffers, their pages are zeroed
+//!   lazily by the system so it doesn't depend on their size, and starts a worker thread,
+//! - the worker thread copies the most recent history while the perform method keeps writing the current buffers,
+//! - pa_ringbuffer_resizer_swap() (at the start of each block) swaps the buffers once the copy is done:
+//!   it only copies the samples written since then, the worker thread frees the old buffers afterwards.
+//! The buffers are resized together (the lines of a network), at the same block.
+//! A request made while a resize is running is queued, only the last queued one is kept.
+//! The dsp, clear and free methods must call pa_ringbuffer_resizer_finish() before touching the buffers.
+
+#ifndef PA_RINGBUFFER_RESIZER_H
+#define PA_RINGBUFFER_RESIZER_H
+
+#include "pa_ringbuffer.h"
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <time.h> // nanosleep
+#endif
+
+#if defined(_MSC_VER)
+#define PA_RESIZER_LOAD(p)      InterlockedCompareExchange((volatile LONG*)(p), 0, 0)
+#define PA_RESIZER_STORE(p, v)  InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#else
+#define PA_RESIZER_LOAD(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PA_RESIZER_STORE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+//! @brief The states of a resize.
+enum
+{
+    PA_RESIZER_IDLE = 0,
+    PA_RESIZER_COPYING,     // the worker copies the history in the new buffers
+    PA_RESIZER_READY,       // the new buffers wait for the next block
+    PA_RESIZER_SWAPPED      // the old buffers wait to be freed by the worker
+};
+
+typedef struct _pa_ringbuffer_resizer
+{
+    t_pa_ringbuffer*    m_buffers;      // the ringbuffers of the object
+    int                 m_count;
+    int                 m_size;         // usable size of the last request
+
+    t_pa_ringbuffer*    m_next;         // the new buffers of the running resize, then the old ones
+    t_pa_ringbuffer*    m_queued;       // the new buffers of the next resize
+    t_pa_ringbuffer*    m_spare;        // allocated by the method before they are queued
+    int                 m_headroom;     // of the running resize
+    int                 m_queued_headroom;
+    int                 m_has_queued;
+
+    int*                m_writers;      // the writer of each buffer when m_reference samples were written
+    int*                m_filled;       // the filled samples of each buffer at the same time
+    unsigned int        m_reference;
+    unsigned int        m_copied;       // number of samples written when the worker copied the history
+    unsigned int        m_written;      // number of samples written in the buffers (wraps around)
+    int                 m_block;        // size of the block being written, counted at the next block
+    int                 m_state;
+
+    int                 m_running;      // 1 while the worker thread runs (under the lock)
+    int                 m_started;      // 1 if the thread must be joined
+#if defined(_WIN32)
+    HANDLE              m_thread;
+    CRITICAL_SECTION    m_lock;
+#else
+    pthread_t           m_thread;
+    pthread_mutex_t     m_lock;
+#endif
+
+} t_pa_ringbuffer_resizer;
+
+static inline void pa_ringbuffer_resizer_lock(t_pa_ringbuffer_resizer* r)
+{
+#if defined(_WIN32)
+    EnterCriticalSection(&r->m_lock);
+#else
+    pthread_mutex_lock(&r->m_lock);
+#endif
+}
+
+static inline void pa_ringbuffer_resizer_unlock(t_pa_ringbuffer_resizer* r)
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(&r->m_lock);
+#else
+    pthread_mutex_unlock(&r->m_lock);
+#endif
+}
+
+static inline void pa_ringbuffer_resizer_sleep(void)
+{
+#if defined(_WIN32)
+    Sleep(1);
+#else
+    const struct timespec delay = {0, 1000000};
+    nanosleep(&delay, NULL);
+#endif
+}
+
+//! @brief Returns the number of samples of the history of a buffer that are copied to the new one
+//! when written samples were written, only the samples written since the buffer was zeroed are copied.
+static inline int pa_ringbuffer_resizer_history(t_pa_ringbuffer_resizer const* r, int i, unsigned int written)
+{
+    t_pa_ringbuffer const* current = r->m_buffers + i;
+    t_pa_ringbuffer const* next = r->m_next + i;
+    const unsigned int since = written - r->m_reference;
+    const int filled = (since < (unsigned int)(current->m_allocsize - r->m_filled[i])) ?
+                       (r->m_filled[i] + (int)since) : current->m_allocsize;
+    int count = current->m_buffer ? (current->m_size + r->m_headroom) : 0;
+    if(count > filled) count = filled;
+    if(count > next->m_allocsize) count = next->m_allocsize;
+    return count;
+}
+
+//! @brief Copy the history of the current buffers in the new ones (worker thread).
+//! @details The history ends at the last block written, the perform method writes the next ones meanwhile:
+//! if it writes more than the free part of the current buffers before the copy is done, the oldest copied
+//! samples may be newer ones, pa_ringbuffer_resizer_apply() clears them.
+static inline void pa_ringbuffer_resizer_copy(t_pa_ringbuffer_resizer* r)
+{
+    const unsigned int written = (unsigned int)PA_RESIZER_LOAD(&r->m_written);
+    int i;
+
+    for(i = 0; i < r->m_count; ++i)
+    {
+        t_pa_ringbuffer const* current = r->m_buffers + i;
+        t_pa_ringbuffer* next = r->m_next + i;
+        const int count = pa_ringbuffer_resizer_history(r, i, written);
+
+        if(count > 0)
+        {
+            const int end = (int)(((unsigned int)r->m_writers[i] + (written - r->m_reference)) & (unsigned int)current->m_mask);
+            const int start = (end - count) & current->m_mask;
+            const int first = (count < current->m_allocsize - start) ? count : (current->m_allocsize - start);
+
+            memcpy(next->m_buffer, current->m_buffer + start, sizeof(float) * first);
+            memcpy(next->m_buffer + first, current->m_buffer, sizeof(float) * (count - first));
+        }
+    }
+
+    r->m_copied = written;
+    PA_RESIZER_STORE(&r->m_state, PA_RESIZER_READY);
+}
+
+//! @brief Swap the new buffers with the current ones (audio thread, the copy is done).
+static inline void pa_ringbuffer_resizer_apply(t_pa_ringbuffer_resizer* r)
+{
+    const unsigned int since = r->m_written - r->m_copied;
+    int i, j;
+
+    for(i = 0; i < r->m_count; ++i)
+    {
+        t_pa_ringbuffer* current = r->m_buffers + i;
+        t_pa_ringbuffer* next = r->m_next + i;
+        const int count = pa_ringbuffer_resizer_history(r, i, r->m_copied);
+        const unsigned int unused = (unsigned int)(current->m_allocsize - count);
+        const unsigned int nwritten = (since < (unsigned int)count) ? since : (unsigned int)count;
+        const int writer = (int)(((unsigned int)count + since) & (unsigned int)next->m_mask);
+        t_pa_ringbuffer swapped;
+
+        // the samples that may have been overwritten while they were copied
+        if(count > 0 && since > unused)
+        {
+            const unsigned int overwritten = since - unused;
+            memset(next->m_buffer, 0, sizeof(float) * ((overwritten < (unsigned int)count) ? overwritten : (unsigned int)count));
+        }
+
+        // the samples written since the copy
+        if(current->m_buffer)
+        {
+            for(j = (int)nwritten; j > 0; --j)
+            {
+                next->m_buffer[(writer - j) & next->m_mask] = current->m_buffer[(current->m_writer - j) & current->m_mask];
+            }
+        }
+
+        next->m_writer = writer;
+        next->m_filled = (since < (unsigned int)(next->m_allocsize - count)) ? (count + (int)since) : next->m_allocsize;
+        memcpy(next->m_buffer + next->m_allocsize, next->m_buffer, sizeof(float) * PA_RINGBUFFER_GUARD);
+
+        swapped = *current;
+        *current = *next;
+        *next = swapped;
+
+        r->m_writers[i] = current->m_writer;
+        r->m_filled[i] = current->m_filled;
+    }
+
+    r->m_reference = r->m_written;
+    PA_RESIZER_STORE(&r->m_state, PA_RESIZER_SWAPPED);
+}
+
+//! @brief The worker thread: copies the history, waits for the swap, frees the old buffers, then runs the queued resize.
+#if defined(_WIN32)
+static inline DWORD WINAPI pa_ringbuffer_resizer_worker(LPVOID arg)
+#else
+static inline void* pa_ringbuffer_resizer_worker(void* arg)
+#endif
+{
+    t_pa_ringbuffer_resizer* r = (t_pa_ringbuffer_resizer*)arg;
+    int i;
+
+    for(;;)
+    {
+        pa_ringbuffer_resizer_copy(r);
+
+        while(PA_RESIZER_LOAD(&r->m_state) != PA_RESIZER_SWAPPED)
+        {
+            pa_ringbuffer_resizer_sleep();
+        }
+
+        for(i = 0; i < r->m_count; ++i)
+        {
+            pa_ringbuffer_free(r->m_next + i);
+        }
+
+        pa_ringbuffer_resizer_lock(r);
+
+        if(!r->m_has_queued)
+        {
+            PA_RESIZER_STORE(&r->m_state, PA_RESIZER_IDLE);
+            r->m_running = 0;
+            pa_ringbuffer_resizer_unlock(r);
+            break;
+        }
+
+        t_pa_ringbuffer* next = r->m_next;
+        r->m_next = r->m_queued;
+        r->m_queued = next;
+        r->m_headroom = r->m_queued_headroom;
+        r->m_has_queued = 0;
+        PA_RESIZER_STORE(&r->m_state, PA_RESIZER_COPYING);
+
+        pa_ringbuffer_resizer_unlock(r);
+    }
+
+    return 0;
+}
+
+//! @brief Initialize a resizer for count ringbuffers, they must be initialized first.
+//! @return 0 on success, -1 if the allocation failed.
+static inline int pa_ringbuffer_resizer_init(t_pa_ringbuffer_resizer* r, t_pa_ringbuffer* buffers, int count)
+{
+    r->m_buffers = buffers;
+    r->m_count = count;
+    r->m_size = (count > 0) ? buffers[0].m_size : 0;
+    r->m_next = (t_pa_ringbuffer*)calloc(count, sizeof(t_pa_ringbuffer));
+    r->m_queued = (t_pa_ringbuffer*)calloc(count, sizeof(t_pa_ringbuffer));
+    r->m_spare = (t_pa_ringbuffer*)calloc(count, sizeof(t_pa_ringbuffer));
+    r->m_writers = (int*)calloc(count, sizeof(int));
+    r->m_filled = (int*)calloc(count, sizeof(int));
+    r->m_headroom = r->m_queued_headroom = 0;
+    r->m_has_queued = 0;
+    r->m_reference = r->m_copied = r->m_written = 0;
+    r->m_block = 0;
+    r->m_state = PA_RESIZER_IDLE;
+    r->m_running = r->m_started = 0;
+
+#if defined(_WIN32)
+    InitializeCriticalSection(&r->m_lock);
+#else
+    pthread_mutex_init(&r->m_lock, NULL);
+#endif
+
+    return (r->m_next && r->m_queued && r->m_spare && r->m_writers && r->m_filled) ? 0 : -1;
+}
+
+//! @brief Returns the usable size of the last request (the current one if there was no request).
+static inline int pa_ringbuffer_resizer_size(t_pa_ringbuffer_resizer const* r)
+{
+    return r->m_size;
+}
+
+//! @brief Count the last block and swap the buffers if a resize is ready, call it at the start of each block.
+//! @details It is cheap when no resize is ready: the buffers are only swapped here, the perform method
+//! sees the old or the new ones for a whole block.
+//! @return 1 if the buffers were swapped, 0 otherwise.
+static inline int pa_ringbuffer_resizer_swap(t_pa_ringbuffer_resizer* r, int n)
+{
+    // only this thread writes the counter, the worker thread reads it
+    PA_RESIZER_STORE(&r->m_written, r->m_written + (unsigned int)r->m_block);
+    r->m_block = n;
+
+    if(PA_RESIZER_LOAD(&r->m_state) != PA_RESIZER_READY)
+    {
+        return 0;
+    }
+
+    pa_ringbuffer_resizer_apply(r);
+    return 1;
+}
+
+//! @brief Wait for the running and queued resizes and apply them.
+//! @details Call it from the methods that change or free the buffers, it doesn't wait if no resize is running.
+static inline void pa_ringbuffer_resizer_finish(t_pa_ringbuffer_resizer* r)
+{
+    int running;
+
+    // the last block is written, the worker must copy it
+    PA_RESIZER_STORE(&r->m_written, r->m_written + (unsigned int)r->m_block);
+    r->m_block = 0;
+
+    for(;;)
+    {
+        pa_ringbuffer_resizer_lock(r);
+        running = r->m_running;
+        pa_ringbuffer_resizer_unlock(r);
+
+        if(!running) break;
+
+        if(PA_RESIZER_LOAD(&r->m_state) == PA_RESIZER_READY)
+        {
+            pa_ringbuffer_resizer_apply(r);
+        }
+        else
+        {
+            pa_ringbuffer_resizer_sleep();
+        }
+    }
+
+    if(r->m_started)
+    {
+#if defined(_WIN32)
+        WaitForSingleObject(r->m_thread, INFINITE);
+        CloseHandle(r->m_thread);
+#else
+        pthread_join(r->m_thread, NULL);
+#endif
+        r->m_started = 0;
+    }
+}
+
+//! @brief Resize the ringbuffers to a usable size with headroom samples after it (see pa_ringbuffer_resize()).
+//! @details The buffers are allocated here and swapped by pa_ringbuffer_resizer_swap() a few blocks later.
+//! If the worker thread can't be started, the resize is done here.
+//! @return 0 on success, -1 if the allocation failed or if size + headroom is greater than PA_RINGBUFFER_MAX_SIZE
+//! (the ringbuffers are then unchanged).
+static inline int pa_ringbuffer_resizer_request(t_pa_ringbuffer_resizer* r, int size, int headroom)
+{
+    int running, i;
+
+    if(!r->m_next || !r->m_queued || !r->m_spare || !r->m_writers || !r->m_filled) return -1;
+    if(size < 1) size = 1;
+    if(headroom < 0) headroom = 0;
+    if((size_t)size + (size_t)headroom > PA_RINGBUFFER_MAX_SIZE) return -1;
+
+    for(i = 0; i < r->m_count; ++i)
+    {
+        if(pa_ringbuffer_init_headroom(r->m_spare + i, size, headroom))
+        {
+            while(i >= 0) pa_ringbuffer_free(r->m_spare + i--);
+            return -1;
+        }
+    }
+
+    r->m_size = size;
+
+    pa_ringbuffer_resizer_lock(r);
+    running = r->m_running;
+
+    if(running)
+    {
+        // the worker runs the queued resize after the current one, the replaced one is freed here
+        t_pa_ringbuffer* queued = r->m_queued;
+        const int replaced = r->m_has_queued;
+
+        r->m_queued = r->m_spare;
+        r->m_spare = queued;
+        r->m_queued_headroom = headroom;
+        r->m_has_queued = 1;
+        pa_ringbuffer_resizer_unlock(r);
+
+        for(i = 0; replaced && i < r->m_count; ++i)
+        {
+            pa_ringbuffer_free(r->m_spare + i);
+        }
+
+        return 0;
+    }
+
+    pa_ringbuffer_resizer_unlock(r);
+
+    // the previous worker has finished
+    pa_ringbuffer_resizer_finish(r);
+
+    for(i = 0; i < r->m_count; ++i)
+    {
+        r->m_writers[i] = r->m_buffers[i].m_writer;
+        r->m_filled[i] = r->m_buffers[i].m_filled;
+    }
+
+    t_pa_ringbuffer* next = r->m_next;
+    r->m_next = r->m_spare;
+    r->m_spare = next;
+    r->m_headroom = headroom;
+    r->m_reference = r->m_written;
+    r->m_running = 1;
+    PA_RESIZER_STORE(&r->m_state, PA_RESIZER_COPYING);
+
+#if defined(_WIN32)
+    r->m_thread = CreateThread(NULL, 0, pa_ringbuffer_resizer_worker, r, 0, NULL);
+    r->m_started = (r->m_thread != NULL);
+#else
+    r->m_started = (pthread_create(&r->m_thread, NULL, pa_ringbuffer_resizer_worker, r) == 0);
+#endif
+
+    if(!r->m_started)
+    {
+        pa_ringbuffer_resizer_copy(r);
+        pa_ringbuffer_resizer_apply(r);
+
+        for(i = 0; i < r->m_count; ++i)
+        {
+            pa_ringbuffer_free(r->m_next + i);
+        }
+
+        r->m_running = 0;
+        PA_RESIZER_STORE(&r->m_state, PA_RESIZER_IDLE);
+    }
+
+    return 0;
+}
+
+//! @brief Wait for the running resize and free the buffers of the resizer (not the ringbuffers).
+static inline void pa_ringbuffer_resizer_free(t_pa_ringbuffer_resizer* r)
+{
+    int i;
+
+    // the queued resize is useless
+    pa_ringbuffer_resizer_lock(r);
+    if(r->m_has_queued)
+    {
+        for(i = 0; i < r->m_count; ++i)
+        {
+            pa_ringbuffer_free(r->m_queued + i);
+        }
+
+        r->m_has_queued = 0;
+    }
+    pa_ringbuffer_resizer_unlock(r);
+
+    pa_ringbuffer_resizer_finish(r);
+
+#if defined(_WIN32)
+    DeleteCriticalSection(&r->m_lock);
+#else
+    pthread_mutex_destroy(&r->m_lock);
+#endif
+
+    free(r->m_next);
+    free(r->m_queued);
+    free(r->m_spare);
+    free(r->m_writers);
+    free(r->m_filled);
+}
+
+#endif // PA_RINGBUFFER_RESIZER_H
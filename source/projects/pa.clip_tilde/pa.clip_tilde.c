@@ -5,22 +5,168 @@
 */
 
 //! @brief clip a signal input between a minimum and maximum value.
+//! @details The clipping is hard (min/max) or soft (a tanh approximation or a cubic curve that reaches
+//! the bounds smoothly). The bounds are floats, or signals with the -signal flag.
+//! The kernels process 4 samples at a time with SSE when it is available, the remaining samples
+//! (and the other architectures) use the scalar version of the same formulas.
 
 #include <m_pd.h>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PA_CLIP_SSE 1
+#include <xmmintrin.h>
+#endif
+
+typedef enum _pa_clip_mode
+{
+    PA_CLIP_HARD,
+    PA_CLIP_TANH,
+    PA_CLIP_CUBIC
+
+} t_pa_clip_mode;
+
 static t_class *pa_clip_tilde_class;
 
 typedef struct _pa_clip_tilde
 {
     t_object    m_obj;
-    
+
     float       m_min;
     float       m_max;
+    int         m_mode;
+    int         m_signal;       // the bounds are the signals of the 2nd and 3rd inlets
+    t_inlet*    m_min_in;
+    t_inlet*    m_max_in;
     t_outlet*   m_out;
-    
+
     t_float     m_f;
 } t_pa_clip_tilde;
 
+// ================================================================================ //
+//                                      KERNELS                                     //
+// ================================================================================ //
+
+// The soft modes work on the input scaled to -1..1 between the bounds :
+// tanh  : u * (27 + u^2) / (27 + 9 u^2), a Padé approximant reaching 1 with a zero slope at u = 3.
+// cubic : u - (4/27) u^3, reaching 1 with a zero slope at u = 1.5 (unity gain around 0).
+
+//! @brief Clip one sample, lo must not be greater than hi.
+//! @details NaN inputs are clipped to lo, like the SSE version.
+static inline float pa_clip_sample(const int mode, float x, float lo, float hi)
+{
+    if(mode == PA_CLIP_HARD)
+    {
+        x = (x > lo) ? x : lo;
+        return (x < hi) ? x : hi;
+    }
+    else
+    {
+        const float center = (lo + hi) * 0.5f;
+        const float half = (hi - lo) * 0.5f;
+        const float limit = (mode == PA_CLIP_TANH) ? 3.f : 1.5f;
+        const float inv = (half > 0.f) ? 1.f / half : 0.f;
+        float u = (x - center) * inv;
+
+        u = (u > -limit) ? u : -limit;
+        u = (u < limit) ? u : limit;
+
+        const float u2 = u * u;
+        const float y = (mode == PA_CLIP_TANH) ? u * (27.f + u2) / (27.f + 9.f * u2) : u - (4.f / 27.f) * u * u2;
+
+        return center + half * y;
+    }
+}
+
+#if defined(PA_CLIP_SSE)
+
+//! @brief Clip 4 samples, the lanes of lo must not be greater than the ones of hi.
+static inline __m128 pa_clip_sse(const int mode, __m128 x, __m128 lo, __m128 hi)
+{
+    if(mode == PA_CLIP_HARD)
+    {
+        return _mm_min_ps(_mm_max_ps(x, lo), hi);
+    }
+    else
+    {
+        const __m128 half = _mm_mul_ps(_mm_sub_ps(hi, lo), _mm_set1_ps(0.5f));
+        const __m128 center = _mm_mul_ps(_mm_add_ps(hi, lo), _mm_set1_ps(0.5f));
+        const __m128 limit = _mm_set1_ps((mode == PA_CLIP_TANH) ? 3.f : 1.5f);
+
+        // 1 / half, 0 where the bounds are equal
+        const __m128 inv = _mm_and_ps(_mm_cmpgt_ps(half, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1.f), half));
+
+        __m128 u = _mm_mul_ps(_mm_sub_ps(x, center), inv);
+        u = _mm_min_ps(_mm_max_ps(u, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+
+        const __m128 u2 = _mm_mul_ps(u, u);
+        __m128 y;
+
+        if(mode == PA_CLIP_TANH)
+        {
+            const __m128 num = _mm_mul_ps(u, _mm_add_ps(_mm_set1_ps(27.f), u2));
+            const __m128 den = _mm_add_ps(_mm_set1_ps(27.f), _mm_mul_ps(_mm_set1_ps(9.f), u2));
+            y = _mm_div_ps(num, den);
+        }
+        else
+        {
+            y = _mm_sub_ps(u, _mm_mul_ps(_mm_set1_ps(4.f / 27.f), _mm_mul_ps(u, u2)));
+        }
+
+        return _mm_add_ps(center, _mm_mul_ps(half, y));
+    }
+}
+
+#endif
+
+//! @brief Clip a block between the bounds, or between the signals mins and maxs when they aren't NULL.
+//! @details It is inlined for each mode. The output may be the same vector as any of the inputs :
+//! all the inputs of a group of samples are read before its outputs are written.
+static inline void pa_clip_block(const int mode, t_sample const* in, t_sample* out,
+                                 t_sample const* mins, t_sample const* maxs, float min, float max, int n)
+{
+    int i = 0;
+
+#if defined(PA_CLIP_SSE)
+    if(mins && maxs)
+    {
+        for(; i + 4 <= n; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps(mins + i);
+            const __m128 b = _mm_loadu_ps(maxs + i);
+            const __m128 x = _mm_loadu_ps(in + i);
+            _mm_storeu_ps(out + i, pa_clip_sse(mode, x, _mm_min_ps(a, b), _mm_max_ps(a, b)));
+        }
+    }
+    else
+    {
+        const __m128 lo = _mm_set1_ps(min);
+        const __m128 hi = _mm_set1_ps(max);
+
+        for(; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(out + i, pa_clip_sse(mode, _mm_loadu_ps(in + i), lo, hi));
+        }
+    }
+#endif
+
+    for(; i < n; ++i)
+    {
+        float lo = min, hi = max;
+
+        if(mins && maxs)
+        {
+            lo = (mins[i] < maxs[i]) ? mins[i] : maxs[i];
+            hi = (mins[i] < maxs[i]) ? maxs[i] : mins[i];
+        }
+
+        out[i] = pa_clip_sample(mode, in[i], lo, hi);
+    }
+}
+
+// ================================================================================ //
+//                                      OBJECT                                      //
+// ================================================================================ //
+
 static void pa_clip_tilde_set_minmax(t_pa_clip_tilde *x, float min, float max)
 {
     if(min <= max)
@@ -37,45 +183,105 @@ static void pa_clip_tilde_set_minmax(t_pa_clip_tilde *x, float min, float max)
 
 static void pa_clip_tilde_set_min(t_pa_clip_tilde *x, float value)
 {
+    if(x->m_signal)
+    {
+        pd_error(x, "pa.clip~: the minimum is set by the second inlet");
+        return;
+    }
+
     pa_clip_tilde_set_minmax(x, value, x->m_max);
 }
 
 static void pa_clip_tilde_set_max(t_pa_clip_tilde *x, float value)
 {
+    if(x->m_signal)
+    {
+        pd_error(x, "pa.clip~: the maximum is set by the third inlet");
+        return;
+    }
+
     pa_clip_tilde_set_minmax(x, x->m_min, value);
 }
 
+static void pa_clip_tilde_set_mode(t_pa_clip_tilde *x, t_symbol* mode)
+{
+    if(mode == gensym("hard"))
+    {
+        x->m_mode = PA_CLIP_HARD;
+    }
+    else if(mode == gensym("tanh"))
+    {
+        x->m_mode = PA_CLIP_TANH;
+    }
+    else if(mode == gensym("cubic"))
+    {
+        x->m_mode = PA_CLIP_CUBIC;
+    }
+    else
+    {
+        pd_error(x, "pa.clip~: unknown mode %s (hard, tanh or cubic)", mode->s_name);
+    }
+}
+
 static t_int *pa_clip_tilde_perform(t_int *w)
 {
     t_pa_clip_tilde *x = (t_pa_clip_tilde *)(w[1]);
     t_sample  *in = (t_sample *)(w[2]);
     t_sample  *out = (t_sample *)(w[3]);
     int vectorsize = (int)(w[4]);
-    
+
     const float min = x->m_min;
     const float max = x->m_max;
-    float value = 0.f;
 
-    while(vectorsize--)
+    switch(x->m_mode)
     {
-        value = *in++;
-        
-        if(value < min) value = min;
-        else if(value > max) value = max;
-        
-        *out++ = value;
+        case PA_CLIP_TANH:  pa_clip_block(PA_CLIP_TANH, in, out, NULL, NULL, min, max, vectorsize); break;
+        case PA_CLIP_CUBIC: pa_clip_block(PA_CLIP_CUBIC, in, out, NULL, NULL, min, max, vectorsize); break;
+        default:            pa_clip_block(PA_CLIP_HARD, in, out, NULL, NULL, min, max, vectorsize); break;
     }
 
     return (w+5);
 }
 
+static t_int *pa_clip_tilde_perform_signal(t_int *w)
+{
+    t_pa_clip_tilde *x = (t_pa_clip_tilde *)(w[1]);
+    t_sample  *in = (t_sample *)(w[2]);
+    t_sample  *mins = (t_sample *)(w[3]);
+    t_sample  *maxs = (t_sample *)(w[4]);
+    t_sample  *out = (t_sample *)(w[5]);
+    int vectorsize = (int)(w[6]);
+
+    switch(x->m_mode)
+    {
+        case PA_CLIP_TANH:  pa_clip_block(PA_CLIP_TANH, in, out, mins, maxs, 0.f, 0.f, vectorsize); break;
+        case PA_CLIP_CUBIC: pa_clip_block(PA_CLIP_CUBIC, in, out, mins, maxs, 0.f, 0.f, vectorsize); break;
+        default:            pa_clip_block(PA_CLIP_HARD, in, out, mins, maxs, 0.f, 0.f, vectorsize); break;
+    }
+
+    return (w+7);
+}
+
 static void pa_clip_tilde_dsp(t_pa_clip_tilde *x, t_signal **sp)
 {
-    dsp_add(pa_clip_tilde_perform, 4,
-            x,
-            sp[0]->s_vec,
-            sp[1]->s_vec,
-            sp[0]->s_n);
+    if(x->m_signal)
+    {
+        dsp_add(pa_clip_tilde_perform_signal, 6,
+                x,
+                sp[0]->s_vec,
+                sp[1]->s_vec,
+                sp[2]->s_vec,
+                sp[3]->s_vec,
+                sp[0]->s_n);
+    }
+    else
+    {
+        dsp_add(pa_clip_tilde_perform, 4,
+                x,
+                sp[0]->s_vec,
+                sp[1]->s_vec,
+                sp[0]->s_n);
+    }
 }
 
 static void *pa_clip_tilde_new(t_symbol *s, int argc, t_atom *argv)
@@ -85,30 +291,51 @@ static void *pa_clip_tilde_new(t_symbol *s, int argc, t_atom *argv)
     {
         float min = -1.;
         float max = 1.;
-        
+
+        x->m_mode = PA_CLIP_HARD;
+        x->m_signal = 0;
+        x->m_min_in = x->m_max_in = NULL;
+
+        // the -signal flag adds signal inlets for the minimum and the maximum
+        if(argc >= 1 && argv[0].a_type == A_SYMBOL && argv[0].a_w.w_symbol == gensym("-signal"))
+        {
+            x->m_signal = 1;
+            argc--;
+            argv++;
+        }
+
         // first argument set the minimum value
         if(argc >= 1 && argv[0].a_type == A_FLOAT)
         {
             min = argv[0].a_w.w_float;
         }
-        
+
         // second argument set the maximum value
         if(argc >= 2 && argv[1].a_type == A_FLOAT)
         {
             max = argv[1].a_w.w_float;
         }
-        
+
         pa_clip_tilde_set_minmax(x, min, max);
-        
+
+        if(x->m_signal)
+        {
+            // the arguments are the values of the inlets while no signal is connected
+            x->m_min_in = signalinlet_new((t_object *)x, min);
+            x->m_max_in = signalinlet_new((t_object *)x, max);
+        }
+
         // creation d'un outlet signal
         x->m_out = outlet_new((t_object *)x, &s_signal);
     }
-    
+
     return (x);
 }
 
 static void pa_clip_tilde_free(t_pa_clip_tilde *x)
 {
+    if(x->m_min_in) inlet_free(x->m_min_in);
+    if(x->m_max_in) inlet_free(x->m_max_in);
     outlet_free(x->m_out);
 }
 
@@ -122,6 +349,7 @@ extern void setup_pa0x2eclip_tilde(void)
         class_addmethod(c, (t_method)pa_clip_tilde_dsp, gensym("dsp"), A_CANT);
         class_addmethod(c, (t_method)pa_clip_tilde_set_min, gensym("min"), A_FLOAT, 0);
         class_addmethod(c, (t_method)pa_clip_tilde_set_max, gensym("max"), A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_clip_tilde_set_mode, gensym("mode"), A_SYMBOL, 0);
         CLASS_MAINSIGNALIN(c, t_pa_clip_tilde, m_f);
     }
     pa_clip_tilde_class = c;
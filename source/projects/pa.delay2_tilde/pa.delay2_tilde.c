@@ -8,7 +8,7 @@
 
 #include <m_pd.h>
 
-#include <stdlib.h> // malloc, calloc, free...
+#include <pa_ringbuffer_resizer.h>
 
 static t_class *pa_delay2_tilde_class;
 
@@ -16,9 +16,9 @@ typedef struct _pa_delay2_tilde
 {
     t_object    m_obj;
     
-    float*      m_buffer;
-    int         m_buffersize;
-    int         m_count;
+    t_pa_ringbuffer m_buffer;
+    t_pa_ringbuffer_resizer m_resizer;   // resizes m_buffer while the dsp runs (see maxdelay)
+    int         m_vecsize;      // last block size, to keep a block of headroom
     
     t_outlet*   m_out;
     
@@ -26,42 +26,23 @@ typedef struct _pa_delay2_tilde
     
 } t_pa_delay2_tilde;
 
-static void pa_delay2_tilde_delete_buffer(t_pa_delay2_tilde* x)
+//! @brief Change the buffer size (in samps), the most recent history is kept.
+//! @details The new buffer is allocated here, the history is copied by a worker thread and the buffers
+//! are swapped at the start of a block (see pa_ringbuffer_resizer.h), the dsp chain isn't rebuilt.
+static void pa_delay2_tilde_set_maxdelay(t_pa_delay2_tilde* x, t_floatarg f)
 {
-    if(x->m_buffer)
+    if(!pa_ringbuffer_isvalidsize(f))
     {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = NULL;
+        pd_error((t_object*)x, "pa.delay2~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+        return;
     }
-}
-
-static void pa_delay2_tilde_clear_buffer(t_pa_delay2_tilde* x)
-{
-    int i = 0;
-    if(x->m_buffer)
-    {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
-    }
-}
-
-static void pa_delay2_tilde_create_buffer(t_pa_delay2_tilde* x)
-{
-    pa_delay2_tilde_delete_buffer(x);
     
-    // allocate buffer
-    x->m_buffer = (float*)malloc(sizeof(float) * x->m_buffersize);
+    const int buffersize = (int)f;
     
-    if(x->m_buffer)
+    if(pa_ringbuffer_resizer_request(&x->m_resizer, buffersize, x->m_vecsize))
     {
-        pa_delay2_tilde_clear_buffer(x);
+        pd_error((t_object*)x, "pa.delay2~: can't allocate a buffer of %d samples", buffersize);
     }
-    
-    // or alloc and init to 0 directly with calloc
-    //x->m_buffer = (float*)calloc(x->m_buffersize, sizeof(float));
 }
 
 static t_int *pa_delay2_tilde_perform(t_int *w)
@@ -71,41 +52,52 @@ static t_int *pa_delay2_tilde_perform(t_int *w)
     t_sample  *out = (t_sample *)(w[3]);
     int vecsize = (int)(w[4]);
     
-    float* buffer = x->m_buffer;
-    int count = x->m_count;
-    float* buffer_playhead = NULL;
-    float sample_to_write = 0.f;
+    pa_ringbuffer_resizer_swap(&x->m_resizer, vecsize);
     
-    int buffersize = x->m_buffersize;
+    t_pa_ringbuffer* buffer = &x->m_buffer;
+    const int delay = buffer->m_size;
+    
+    // fast path: the whole block is written then read back in at most two contiguous segments each
+    if(pa_ringbuffer_can_process_block(buffer, delay, vecsize))
+    {
+        pa_ringbuffer_write_block(buffer, in, vecsize);
+        pa_ringbuffer_read_block(buffer, delay, out, vecsize);
+        return (w+5);
+    }
+    
+    // otherwise the buffer doesn't have enough headroom, process one sample at a time
+    float sample_to_write = 0.f;
     
     while(vecsize--)
     {
         // store current input sample to write in the buffer
         sample_to_write = *in++;
         
-        // fetch buffer pointer playhead position
-        buffer_playhead = buffer + count;
-        
         // we read our buffer.
-        *out++ = *buffer_playhead;
-        
-        // then store incoming sample to the buffer.
-        *buffer_playhead = sample_to_write;
+        *out++ = pa_ringbuffer_read(buffer, delay);
         
-        // wrap counter between buffer boundaries
-        if(++count >= buffersize) count = 0;
+        // then store incoming sample to the buffer (the writer wraps by itself).
+        pa_ringbuffer_write(buffer, sample_to_write);
     }
     
-    x->m_count = count;
-    
     return (w+5);
 }
 
 static void pa_delay2_tilde_dsp(t_pa_delay2_tilde *x, t_signal **sp)
 {
+    x->m_vecsize = sp[0]->s_n;
+    
+    // the buffer is resized before the headroom is reserved
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    
+    // keep a block of headroom so that the perform method can write a whole block before reading it
+    if(pa_ringbuffer_reserve(&x->m_buffer, x->m_buffer.m_size + x->m_vecsize))
+    {
+        pd_error((t_object*)x, "pa.delay2~: can't allocate the block headroom, processing samples one by one");
+    }
+    
     // as you want :
-    //pa_delay2_tilde_clear_buffer(x);
-    //x->m_count = 0;
+    //pa_ringbuffer_clear(&x->m_buffer);
     
     dsp_add(pa_delay2_tilde_perform, 4,
             x,              // object
@@ -120,27 +112,32 @@ static void *pa_delay2_tilde_new(t_symbol *s, int argc, t_atom *argv)
     
     if(x)
     {
-        x->m_buffer = NULL;
-        x->m_count = 0;
+        x->m_vecsize = sys_getblksize();
         
         int buffersize = sys_getsr() * 0.1; // default to 100ms
         
         if(argc >= 1 && argv->a_type == A_FLOAT)
         {
-            if(argv->a_w.w_float > 0)
+            if(pa_ringbuffer_isvalidsize(argv->a_w.w_float))
             {
                 buffersize = (int)argv->a_w.w_float;
             }
             else
             {
-                pd_error((t_object*)x, "buffer size must be > 1");
+                pd_error((t_object*)x, "pa.delay2~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
             }
         }
         
-        x->m_buffersize = buffersize;
+        // allocate our buffer with the headroom that the dsp method reserves.
+        if(pa_ringbuffer_init_headroom(&x->m_buffer, buffersize, x->m_vecsize))
+        {
+            pd_error((t_object*)x, "pa.delay2~: can't allocate a buffer of %d samples", buffersize);
+        }
         
-        // reset our buffer.
-        pa_delay2_tilde_create_buffer(x);
+        if(pa_ringbuffer_resizer_init(&x->m_resizer, &x->m_buffer, 1))
+        {
+            pd_error((t_object*)x, "pa.delay2~: can't allocate the resizer");
+        }
         
         // create one signal outlet:
         x->m_out = outlet_new((t_object *)x, &s_signal);
@@ -152,7 +149,8 @@ static void *pa_delay2_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
 static void pa_delay2_tilde_free(t_pa_delay2_tilde *x)
 {
-    pa_delay2_tilde_delete_buffer(x);
+    pa_ringbuffer_resizer_free(&x->m_resizer);
+    pa_ringbuffer_free(&x->m_buffer);
     outlet_free(x->m_out);
 }
 
@@ -165,6 +163,7 @@ extern void setup_pa0x2edelay2_tilde(void)
     {
         class_addmethod(c, (t_method)pa_delay2_tilde_dsp, gensym("dsp"), A_CANT);
         CLASS_MAINSIGNALIN(c, t_pa_delay2_tilde, m_f);
+        class_addmethod(c, (t_method)pa_delay2_tilde_set_maxdelay, gensym("maxdelay"), A_FLOAT, 0);
     }
     pa_delay2_tilde_class = c;
 }
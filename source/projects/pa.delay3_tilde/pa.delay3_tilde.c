@@ -8,7 +8,7 @@
 
 #include <m_pd.h>
 
-#include <stdlib.h> // malloc, calloc, free...
+#include <pa_ringbuffer_resizer.h>
 
 static t_class *pa_delay3_tilde_class;
 
@@ -16,11 +16,10 @@ typedef struct _pa_delay3_tilde
 {
     t_object    m_obj;
     
-    float*      m_buffer;
-    int         m_buffersize;
-    
-    int         m_writer_playhead;
-    int         m_reader_playhead;
+    t_pa_ringbuffer m_buffer;
+    t_pa_ringbuffer_resizer m_resizer;   // resizes m_buffer while the dsp runs (see maxdelay)
+    int         m_vecsize;      // last block size, to keep a block of headroom
+    int         m_delay;
     
     t_outlet*   m_out;
     
@@ -28,34 +27,10 @@ typedef struct _pa_delay3_tilde
     
 } t_pa_delay3_tilde;
 
-static void pa_delay3_tilde_delete_buffer(t_pa_delay3_tilde* x)
-{
-    if(x->m_buffer)
-    {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = NULL;
-    }
-}
-
 static void pa_delay3_tilde_clear_buffer(t_pa_delay3_tilde* x)
 {
-    int i = 0;
-    if(x->m_buffer)
-    {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
-    }
-}
-
-static void pa_delay3_tilde_create_buffer(t_pa_delay3_tilde* x)
-{
-    pa_delay3_tilde_delete_buffer(x);
-    
-    // or alloc and init to 0 directly with calloc
-    x->m_buffer = (float*)calloc(x->m_buffersize, sizeof(float));
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    pa_ringbuffer_clear(&x->m_buffer);
 }
 
 static void pa_delay3_tilde_set_size_in_samps(t_pa_delay3_tilde* x, float f)
@@ -63,23 +38,43 @@ static void pa_delay3_tilde_set_size_in_samps(t_pa_delay3_tilde* x, float f)
     int delay_samps = (int)f;
     
     // clip to buffersize
-    if(delay_samps > x->m_buffersize)
+    if(delay_samps > pa_ringbuffer_resizer_size(&x->m_resizer))
     {
-        delay_samps = x->m_buffersize;
+        delay_samps = pa_ringbuffer_resizer_size(&x->m_resizer);
     }
     else if(delay_samps < 1)
     {
         delay_samps = 1;
     }
     
-    int reader_playhead = x->m_writer_playhead - delay_samps;
+    // the reader follows the writer, so we only need to store the delay
+    x->m_delay = delay_samps;
+}
+
+//! @brief Change the buffer size (in samps), the most recent history is kept.
+//! @details The new buffer is allocated here, the history is copied by a worker thread and the buffers
+//! are swapped at the start of a block (see pa_ringbuffer_resizer.h), the dsp chain isn't rebuilt.
+static void pa_delay3_tilde_set_maxdelay(t_pa_delay3_tilde* x, t_floatarg f)
+{
+    if(!pa_ringbuffer_isvalidsize(f))
+    {
+        pd_error((t_object*)x, "pa.delay3~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+        return;
+    }
+    
+    const int buffersize = (int)f;
     
-    if(reader_playhead < 0)
+    if(pa_ringbuffer_resizer_request(&x->m_resizer, buffersize, x->m_vecsize))
     {
-        reader_playhead += x->m_buffersize;
+        pd_error((t_object*)x, "pa.delay3~: can't allocate a buffer of %d samples", buffersize);
+        return;
     }
     
-    x->m_reader_playhead = reader_playhead;
+    // the delay can't be greater than the buffer size
+    if(x->m_delay > buffersize)
+    {
+        x->m_delay = buffersize;
+    }
 }
 
 static t_int *pa_delay3_tilde_dsp_perform(t_int *w)
@@ -89,9 +84,22 @@ static t_int *pa_delay3_tilde_dsp_perform(t_int *w)
     t_sample  *out = (t_sample *)(w[3]);
     int vecsize = (int)(w[4]);
     
-    float* buffer = x->m_buffer;
+    pa_ringbuffer_resizer_swap(&x->m_resizer, vecsize);
+    
+    // the delay is clipped to the requested size, the buffer may not be resized yet
+    t_pa_ringbuffer* buffer = &x->m_buffer;
+    const int delay = (x->m_delay < buffer->m_size) ? x->m_delay : buffer->m_size;
+    
+    // fast path: the whole block is written then read back in at most two contiguous segments each
+    if(pa_ringbuffer_can_process_block(buffer, delay, vecsize))
+    {
+        pa_ringbuffer_write_block(buffer, in, vecsize);
+        pa_ringbuffer_read_block(buffer, delay, out, vecsize);
+        return (w+5);
+    }
+    
+    // otherwise the buffer doesn't have enough headroom, process one sample at a time
     float sample_to_write = 0.f;
-    int buffersize = x->m_buffersize;
     
     while(vecsize--)
     {
@@ -99,14 +107,10 @@ static t_int *pa_delay3_tilde_dsp_perform(t_int *w)
         sample_to_write = *in++;
         
         // we read our buffer.
-        *out++ = buffer[x->m_reader_playhead];
+        *out++ = pa_ringbuffer_read(buffer, delay);
         
-        // then store incoming sample to the buffer.
-        buffer[x->m_writer_playhead] = sample_to_write;
-        
-        // wrap counter between buffer boundaries
-        if(++x->m_writer_playhead >= buffersize) x->m_writer_playhead = 0;
-        if(++x->m_reader_playhead >= buffersize) x->m_reader_playhead = 0;
+        // then store incoming sample to the buffer (the writer wraps by itself).
+        pa_ringbuffer_write(buffer, sample_to_write);
     }
     
     return (w+5);
@@ -114,6 +118,17 @@ static t_int *pa_delay3_tilde_dsp_perform(t_int *w)
 
 static void pa_delay3_tilde_dsp_prepare(t_pa_delay3_tilde *x, t_signal **sp)
 {
+    x->m_vecsize = sp[0]->s_n;
+    
+    // the buffer is resized before the headroom is reserved
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    
+    // keep a block of headroom so that the perform method can write a whole block before reading it
+    if(pa_ringbuffer_reserve(&x->m_buffer, x->m_buffer.m_size + x->m_vecsize))
+    {
+        pd_error((t_object*)x, "pa.delay3~: can't allocate the block headroom, processing samples one by one");
+    }
+    
     // as you want :
     //pa_delay3_tilde_clear_buffer(x);
     
@@ -130,27 +145,35 @@ static void *pa_delay3_tilde_new(t_symbol *s, int argc, t_atom *argv)
     
     if(x)
     {
-        x->m_writer_playhead = x->m_reader_playhead = 0;
-        x->m_buffer = NULL;
+        x->m_vecsize = sys_getblksize();
         
         int buffersize = sys_getsr() * 0.1; // default to 100ms
         
         if(argc >= 1 && argv->a_type == A_FLOAT)
         {
-            if(argv->a_w.w_float > 0)
+            if(pa_ringbuffer_isvalidsize(argv->a_w.w_float))
             {
                 buffersize = (int)argv->a_w.w_float;
             }
             else
             {
-                pd_error((t_object*)x, "buffer size must be > 1");
+                pd_error((t_object*)x, "pa.delay3~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
             }
         }
         
-        x->m_buffersize = buffersize;
+        // allocate our buffer with the headroom that the dsp method reserves.
+        if(pa_ringbuffer_init_headroom(&x->m_buffer, buffersize, x->m_vecsize))
+        {
+            pd_error((t_object*)x, "pa.delay3~: can't allocate a buffer of %d samples", buffersize);
+        }
+        
+        if(pa_ringbuffer_resizer_init(&x->m_resizer, &x->m_buffer, 1))
+        {
+            pd_error((t_object*)x, "pa.delay3~: can't allocate the resizer");
+        }
         
-        // reset our buffer.
-        pa_delay3_tilde_create_buffer(x);
+        // defaults to the maximum delay
+        x->m_delay = x->m_buffer.m_size;
         
         // create one signal outlet:
         x->m_out = outlet_new((t_object *)x, &s_signal);
@@ -162,7 +185,8 @@ static void *pa_delay3_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
 static void pa_delay3_tilde_free(t_pa_delay3_tilde *x)
 {
-    pa_delay3_tilde_delete_buffer(x);
+    pa_ringbuffer_resizer_free(&x->m_resizer);
+    pa_ringbuffer_free(&x->m_buffer);
     outlet_free(x->m_out);
 }
 
@@ -176,6 +200,7 @@ extern void setup_pa0x2edelay3_tilde(void)
         class_addmethod(c, (t_method)pa_delay3_tilde_dsp_prepare, gensym("dsp"), A_CANT);
         class_addmethod(c, (t_method)pa_delay3_tilde_set_size_in_samps, gensym("size"), A_FLOAT, 0);
         class_addmethod(c, (t_method)pa_delay3_tilde_clear_buffer, gensym("clear"), 0);
+        class_addmethod(c, (t_method)pa_delay3_tilde_set_maxdelay, gensym("maxdelay"), A_FLOAT, 0);
         CLASS_MAINSIGNALIN(c, t_pa_delay3_tilde, m_f);
     }
     pa_delay3_tilde_class = c;
@@ -8,7 +8,9 @@
 
 #include <m_pd.h>
 
-#include <stdlib.h> // malloc, calloc, free...
+#include <stdlib.h> // malloc, free...
+
+#include <pa_ringbuffer_resizer.h>
 
 static t_class *pa_delay4_tilde_class;
 
@@ -16,9 +18,12 @@ typedef struct _pa_delay4_tilde
 {
     t_object    m_obj;
     
-    float*      m_buffer;
-    int         m_buffersize;
-    int         m_writer_playhead;
+    t_pa_ringbuffer m_buffer;
+    t_pa_ringbuffer_resizer m_resizer;   // resizes m_buffer while the dsp runs (see maxdelay)
+    int         m_vecsize;      // last block size, to keep a block of headroom
+    t_sample*   m_delays;       // a block of delay sizes (allocated in the dsp method)
+    int         m_interp;       // interpolation mode
+    float       m_allpass_state;
     
     t_inlet*    m_in;
     t_outlet*   m_out;
@@ -27,44 +32,44 @@ typedef struct _pa_delay4_tilde
     
 } t_pa_delay4_tilde;
 
-static void pa_delay4_tilde_delete_buffer(t_pa_delay4_tilde* x)
+static void pa_delay4_tilde_clear_buffer(t_pa_delay4_tilde* x)
 {
-    if(x->m_buffer)
-    {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = NULL;
-    }
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    pa_ringbuffer_clear(&x->m_buffer);
+    x->m_allpass_state = 0.f;
 }
 
-static void pa_delay4_tilde_clear_buffer(t_pa_delay4_tilde* x)
+static void pa_delay4_tilde_set_interp(t_pa_delay4_tilde* x, t_symbol* s)
 {
-    int i = 0;
-    if(x->m_buffer)
+    const int mode = pa_ringbuffer_interp_from_name(s->s_name);
+    
+    if(mode < 0)
     {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
+        pd_error((t_object*)x, "pa.delay4~: unknown interpolation %s (linear, hermite, lagrange or allpass)", s->s_name);
+        return;
     }
-}
-
-static void pa_delay4_tilde_create_buffer(t_pa_delay4_tilde* x)
-{
-    pa_delay4_tilde_delete_buffer(x);
     
-    // alloc and init to 0 directly with calloc
-    x->m_buffer = (float*)calloc(x->m_buffersize, sizeof(float));
+    x->m_interp = mode;
+    x->m_allpass_state = 0.f;
 }
 
-static float get_buffer_value(t_pa_delay4_tilde* x, int idx)
+//! @brief Change the buffer size (in samps), the most recent history is kept.
+//! @details The new buffer is allocated here, the history is copied by a worker thread and the buffers
+//! are swapped at the start of a block (see pa_ringbuffer_resizer.h), the dsp chain isn't rebuilt.
+static void pa_delay4_tilde_set_maxdelay(t_pa_delay4_tilde* x, t_floatarg f)
 {
-    const int buffersize = x->m_buffersize;
+    if(!pa_ringbuffer_isvalidsize(f))
+    {
+        pd_error((t_object*)x, "pa.delay4~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+        return;
+    }
     
-    while(idx < 0) idx += buffersize;
-    while(idx >= buffersize) idx -= buffersize;
+    const int buffersize = (int)f;
     
-    return x->m_buffer[idx];
+    if(pa_ringbuffer_resizer_request(&x->m_resizer, buffersize, x->m_vecsize + 1))
+    {
+        pd_error((t_object*)x, "pa.delay4~: can't allocate a buffer of %d samples", buffersize);
+    }
 }
 
 static float linear_interp(float y1, float y2, float delta)
@@ -72,22 +77,20 @@ static float linear_interp(float y1, float y2, float delta)
     return y1 + delta * (y2 - y1);
 }
 
-static t_int *pa_delay4_tilde_dsp_perform(t_int *w)
+//! @brief Process one sample at a time with linear interpolation.
+//! @details Used when the buffer doesn't have a block of headroom.
+static void pa_delay4_tilde_perform_samples(t_pa_delay4_tilde *x,
+                                            t_sample* in1, t_sample* in2, t_sample* out, int vecsize)
 {
-    t_pa_delay4_tilde *x   = (t_pa_delay4_tilde *)(w[1]);
-    t_sample  *in1 = (t_sample *)(w[2]);
-    t_sample  *in2 = (t_sample *)(w[3]);
-    t_sample  *out = (t_sample *)(w[4]);
-    int vecsize = (int)(w[5]);
-    
-    float* buffer = x->m_buffer;
+    t_pa_ringbuffer* buffer = &x->m_buffer;
     float sample_to_write = 0.f;
-    const int buffersize = x->m_buffersize;
+    const int buffersize = buffer->m_size;
     
     float delay_size_samps = 0.f;
     int reader_playhead = 0;
     
     // interpolation values
+    float const* frame;
     float y1, y2, delta;
     
     while(vecsize--)
@@ -110,10 +113,12 @@ static t_int *pa_delay4_tilde_dsp_perform(t_int *w)
         
         delta = delay_size_samps - (int)delay_size_samps;
         
-        reader_playhead = x->m_writer_playhead - (int)delay_size_samps;
+        reader_playhead = buffer->m_writer - (int)delay_size_samps;
         
-        y1 = get_buffer_value(x, reader_playhead);
-        y2 = get_buffer_value(x, reader_playhead - 1);
+        // the guard of the ringbuffer lets us read both points from a single wrapped position
+        frame = pa_ringbuffer_get_frame(buffer, reader_playhead - 1);
+        y2 = frame[0];
+        y1 = frame[1];
         
         // we read our buffer.
         *out++ = linear_interp(y1, y2, delta);
@@ -121,18 +126,56 @@ static t_int *pa_delay4_tilde_dsp_perform(t_int *w)
         // without interpolation:
         //*out++ = y1;
         
-        // then store incoming sample to the buffer.
-        buffer[x->m_writer_playhead] = sample_to_write;
-        
-        // wrap writer playhead between buffer boundaries.
-        if(++x->m_writer_playhead >= buffersize) x->m_writer_playhead = 0;
+        // then store incoming sample to the buffer (the writer wraps by itself).
+        pa_ringbuffer_write(buffer, sample_to_write);
+    }
+}
+
+static t_int *pa_delay4_tilde_dsp_perform(t_int *w)
+{
+    t_pa_delay4_tilde *x   = (t_pa_delay4_tilde *)(w[1]);
+    t_sample  *in1 = (t_sample *)(w[2]);
+    t_sample  *in2 = (t_sample *)(w[3]);
+    t_sample  *out = (t_sample *)(w[4]);
+    int vecsize = (int)(w[5]);
+    
+    pa_ringbuffer_resizer_swap(&x->m_resizer, vecsize);
+    
+    t_pa_ringbuffer* buffer = &x->m_buffer;
+    
+    // the 4-point interpolations read one sample older than the maximum delay
+    if(!pa_ringbuffer_can_process_block(buffer, buffer->m_size + 1, vecsize))
+    {
+        pa_delay4_tilde_perform_samples(x, in1, in2, out, vecsize);
+        return (w+6);
     }
     
+    // store the (clipped) delay sizes first because the output may override them
+    pa_ringbuffer_clip_delays(buffer, in2, x->m_delays, vecsize);
+    
+    // write the whole block, then read it back
+    pa_ringbuffer_write_block(buffer, in1, vecsize);
+    pa_ringbuffer_read_interp_block(buffer, x->m_interp, x->m_delays, out, vecsize, &x->m_allpass_state);
+    
     return (w+6);
 }
 
 static void pa_delay4_tilde_dsp_prepare(t_pa_delay4_tilde *x, t_signal **sp)
 {
+    x->m_vecsize = sp[0]->s_n;
+    
+    // the buffer is resized before the headroom is reserved
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    
+    // keep a block (and one sample) of headroom so that the perform method can write a whole block before reading it
+    if(pa_ringbuffer_reserve(&x->m_buffer, x->m_buffer.m_size + x->m_vecsize + 1))
+    {
+        pd_error((t_object*)x, "pa.delay4~: can't allocate the block headroom, processing samples one by one");
+    }
+    
+    free(x->m_delays);
+    x->m_delays = (t_sample*)malloc(sizeof(t_sample) * sp[0]->s_n);
+    
     // as you want :
     //pa_delay4_tilde_clear_buffer(x);
     
@@ -150,27 +193,36 @@ static void *pa_delay4_tilde_new(t_symbol *s, int argc, t_atom *argv)
     
     if(x)
     {
-        x->m_writer_playhead = 0;
-        x->m_buffer = NULL;
+        x->m_delays = NULL;
+        x->m_interp = PA_RINGBUFFER_INTERP_LINEAR;
+        x->m_allpass_state = 0.f;
+        
+        x->m_vecsize = sys_getblksize();
         
         int buffersize = sys_getsr() * 0.1; // default to 100ms
         
         if(argc >= 1 && argv->a_type == A_FLOAT)
         {
-            if(argv->a_w.w_float > 0)
+            if(pa_ringbuffer_isvalidsize(argv->a_w.w_float))
             {
                 buffersize = (int)argv->a_w.w_float;
             }
             else
             {
-                pd_error((t_object*)x, "buffer size must be > 1");
+                pd_error((t_object*)x, "pa.delay4~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
             }
         }
         
-        x->m_buffersize = buffersize;
+        // allocate our buffer with the headroom that the dsp method reserves.
+        if(pa_ringbuffer_init_headroom(&x->m_buffer, buffersize, x->m_vecsize + 1))
+        {
+            pd_error((t_object*)x, "pa.delay4~: can't allocate a buffer of %d samples", buffersize);
+        }
         
-        // reset our buffer.
-        pa_delay4_tilde_create_buffer(x);
+        if(pa_ringbuffer_resizer_init(&x->m_resizer, &x->m_buffer, 1))
+        {
+            pd_error((t_object*)x, "pa.delay4~: can't allocate the resizer");
+        }
         
         // create delay size control signal inlet
         x->m_in = signalinlet_new((t_object*)x, 0.f);
@@ -185,7 +237,9 @@ static void *pa_delay4_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
 static void pa_delay4_tilde_free(t_pa_delay4_tilde *x)
 {
-    pa_delay4_tilde_delete_buffer(x);
+    pa_ringbuffer_resizer_free(&x->m_resizer);
+    pa_ringbuffer_free(&x->m_buffer);
+    free(x->m_delays);
     inlet_free(x->m_in);
     outlet_free(x->m_out);
 }
@@ -199,6 +253,8 @@ extern void setup_pa0x2edelay4_tilde(void)
     {
         class_addmethod(c, (t_method)pa_delay4_tilde_dsp_prepare, gensym("dsp"), A_CANT);
         class_addmethod(c, (t_method)pa_delay4_tilde_clear_buffer, gensym("clear"), 0);
+        class_addmethod(c, (t_method)pa_delay4_tilde_set_maxdelay, gensym("maxdelay"), A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_delay4_tilde_set_interp, gensym("interp"), A_SYMBOL, 0);
         CLASS_MAINSIGNALIN(c, t_pa_delay4_tilde, m_f);
     }
     pa_delay4_tilde_class = c;
@@ -10,20 +10,26 @@
 
 #include <stdlib.h> // malloc, calloc, free...
 
+#include <pa_ringbuffer_resizer.h>
+
 static t_class *pa_delay5_tilde_class;
 
 typedef struct _pa_delay5_tilde
 {
     t_object    m_obj;
 
-    float*      m_buffer;
-    int         m_buffersize;
-    int         m_writer_playhead;
+    t_pa_ringbuffer m_buffer;
+    t_pa_ringbuffer_resizer m_resizer;   // resizes m_buffer while the dsp runs (see maxdelay)
+    int         m_vecsize;      // last block size, to keep a block of headroom
     int         m_number_of_readers;
     
     t_sample**  m_inputs;
     t_sample**  m_outputs;
     t_sample*   m_delay_sizes;
+    int         m_interp;
+    float*      m_allpass_states;
+    float*      m_mean_delays;  // mean delay of each reader over the last block
+    int*        m_order;        // readers sorted by mean delay, in the order they are processed
 
     t_inlet**   m_inlets;
     t_outlet**  m_outlets;
@@ -33,48 +39,121 @@ typedef struct _pa_delay5_tilde
 
 } t_pa_delay5_tilde;
 
-static void delete_buffer(t_pa_delay5_tilde* x)
+static void clear_allpass_states(t_pa_delay5_tilde* x)
 {
-    if(x->m_buffer)
+    int i = 0;
+    for(; i < x->m_number_of_readers; ++i)
     {
-        // free allocated buffer
-        free(x->m_buffer);
-        x->m_buffer = NULL;
+        x->m_allpass_states[i] = 0.f;
     }
 }
 
 static void clear_buffer(t_pa_delay5_tilde* x)
 {
-    int i = 0;
-    
-    if(x->m_buffer)
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    pa_ringbuffer_clear(&x->m_buffer);
+    clear_allpass_states(x);
+}
+
+static void set_interp(t_pa_delay5_tilde* x, t_symbol* s)
+{
+    const int mode = pa_ringbuffer_interp_from_name(s->s_name);
+
+    if(mode < 0)
     {
-        for(; i < x->m_buffersize; ++i)
-        {
-            x->m_buffer[i] = 0.f;
-        }
+        pd_error((t_object*)x, "pa.delay5~: unknown interpolation %s (linear, hermite, lagrange or allpass)", s->s_name);
+        return;
     }
+
+    x->m_interp = mode;
+    clear_allpass_states(x);
 }
 
-static void create_buffer(t_pa_delay5_tilde* x)
+//! @brief Change the buffer size (in samps), the most recent history is kept.
+//! @details The new buffer is allocated here, the history is copied by a worker thread and the buffers
+//! are swapped at the start of a block (see pa_ringbuffer_resizer.h), the dsp chain isn't rebuilt.
+static void set_maxdelay(t_pa_delay5_tilde* x, t_floatarg f)
 {
-    delete_buffer(x);
+    if(!pa_ringbuffer_isvalidsize(f))
+    {
+        pd_error((t_object*)x, "pa.delay5~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+        return;
+    }
+
+    const int buffersize = (int)f;
+
+    if(pa_ringbuffer_resizer_request(&x->m_resizer, buffersize, x->m_vecsize + 1))
+    {
+        pd_error((t_object*)x, "pa.delay5~: can't allocate a buffer of %d samples", buffersize);
+    }
+}
+
+//! @brief Sort the readers by decreasing mean delay over the block.
+//! @details The readers are then processed from the oldest region of the buffer to the newest,
+//! so that the taps that read neighbouring regions share the cache lines they load.
+//! The order rarely changes from one block to the next, an insertion sort is linear in this case.
+static void sort_readers(t_pa_delay5_tilde* x, int vecsize)
+{
+    int i, j;
+    const float scale = 1.f / vecsize;
+
+    for(i = 0; i < x->m_number_of_readers; ++i)
+    {
+        float const* delays = x->m_delay_sizes + i * vecsize;
+        float sum = 0.f;
+
+        for(j = 0; j < vecsize; ++j)
+        {
+            sum += delays[j];
+        }
+
+        x->m_mean_delays[i] = sum * scale;
+    }
 
-    // allocate and clear buffer
-    x->m_buffer = (float*)calloc(x->m_buffersize, sizeof(float));
+    for(i = 1; i < x->m_number_of_readers; ++i)
+    {
+        const int reader = x->m_order[i];
+        const float mean = x->m_mean_delays[reader];
+
+        for(j = i; j > 0 && x->m_mean_delays[x->m_order[j - 1]] < mean; --j)
+        {
+            x->m_order[j] = x->m_order[j - 1];
+        }
+
+        x->m_order[j] = reader;
+    }
 }
 
-//! @brief returns a buffer value at a given index position.
-//! @details idx will be wrapped between low and high buffer boundaries in a circular way.
-static float get_buffer_value(t_pa_delay5_tilde* x, int idx)
+//! @brief Post the mean delay of each reader over the last block and the spread of the taps in the buffer.
+static void post_stats(t_pa_delay5_tilde* x)
 {
-    const int buffersize = x->m_buffersize;
+    const int nreaders = x->m_number_of_readers;
+    const float msperframe = 1000.f / sys_getsr();
+    float gap = 0.f;
+    int i;
 
-    // wrap idx between low and high buffer boundaries.
-    while(idx < 0) idx += buffersize;
-    while(idx >= buffersize) idx -= buffersize;
+    post("pa.delay5~: %d readers, buffer of %d samples, %s interpolation", nreaders, x->m_buffer.m_size,
+         pa_ringbuffer_interp_name(x->m_interp));
 
-    return x->m_buffer[idx];
+    for(i = 0; i < nreaders; ++i)
+    {
+        const int reader = x->m_order[i];
+        const float mean = x->m_mean_delays[reader];
+
+        if(i > 0)
+        {
+            gap += x->m_mean_delays[x->m_order[i - 1]] - mean;
+        }
+
+        post("  reader %d: mean delay %.1f samps (%.2f ms)", reader + 1, mean, mean * msperframe);
+    }
+
+    if(nreaders > 1)
+    {
+        const float spread = x->m_mean_delays[x->m_order[0]] - x->m_mean_delays[x->m_order[nreaders - 1]];
+        post("  spread: %.1f samps (%.2f ms), mean gap between neighbouring taps: %.1f samps",
+             spread, spread * msperframe, gap / (nreaders - 1));
+    }
 }
 
 static float linear_interp(float y1, float y2, float delta)
@@ -82,23 +161,16 @@ static float linear_interp(float y1, float y2, float delta)
     return y1 + delta * (y2 - y1);
 }
 
-static t_int* pa_delay5_tilde_perform(t_int *w)
+//! @brief Process one sample at a time, for each reader.
+//! @details Used when the buffer doesn't have a block of headroom.
+static void pa_delay5_tilde_perform_samples(t_pa_delay5_tilde* x, t_sample* first_input, int vecsize)
 {
-    t_pa_delay5_tilde* x = (t_pa_delay5_tilde *)(w[1]);
-    int vecsize = (int)(w[2]);
-    t_sample* first_input = (t_sample *)(w[3]);
-
     int i, j;
-    for(i = 0; i < x->m_number_of_readers; ++i)
-    {
-        x->m_inputs[i] = (t_sample*)(w[i + 4]);
-        x->m_outputs[i] = (t_sample*)(w[i + 4 + x->m_number_of_readers]);
-    }
-
+    float const* frame;
     float y1, y2, delta;
     float delay_size_samps = 0.f;
-    float* buffer = x->m_buffer;
-    const int buffersize = x->m_buffersize;
+    t_pa_ringbuffer* buffer = &x->m_buffer;
+    const int buffersize = buffer->m_size;
     float sample_to_write = 0.f;
     int reader;
 
@@ -132,21 +204,65 @@ static t_int* pa_delay5_tilde_perform(t_int *w)
             // extract the fractional part
             delta = delay_size_samps - (int)delay_size_samps;
 
-            reader = x->m_writer_playhead - (int)delay_size_samps;
+            reader = buffer->m_writer - (int)delay_size_samps;
 
-            // Reading our buffer.
-            y1 = get_buffer_value(x, reader);
-            y2 = get_buffer_value(x, reader - 1);
+            // Reading our buffer (the guard of the ringbuffer lets us read both points from a single wrapped position).
+            frame = pa_ringbuffer_get_frame(buffer, reader - 1);
+            y2 = frame[0];
+            y1 = frame[1];
 
             // with linear interpolation
             x->m_outputs[j][i] = linear_interp(y1, y2, delta);
         }
 
-        // then store incoming sample to the buffer.
-        buffer[x->m_writer_playhead] = sample_to_write;
+        // then store incoming sample to the buffer (the writer wraps by itself).
+        pa_ringbuffer_write(buffer, sample_to_write);
+    }
+
+}
+
+static t_int* pa_delay5_tilde_perform(t_int *w)
+{
+    t_pa_delay5_tilde* x = (t_pa_delay5_tilde *)(w[1]);
+    int vecsize = (int)(w[2]);
+    t_sample* first_input = (t_sample *)(w[3]);
+
+    int i;
+    for(i = 0; i < x->m_number_of_readers; ++i)
+    {
+        x->m_inputs[i] = (t_sample*)(w[i + 4]);
+        x->m_outputs[i] = (t_sample*)(w[i + 4 + x->m_number_of_readers]);
+    }
+
+    pa_ringbuffer_resizer_swap(&x->m_resizer, vecsize);
+
+    t_pa_ringbuffer* buffer = &x->m_buffer;
+
+    // the 4-point interpolations read one sample older than the maximum delay
+    if(!pa_ringbuffer_can_process_block(buffer, buffer->m_size + 1, vecsize))
+    {
+        pa_delay5_tilde_perform_samples(x, first_input, vecsize);
+        return (w + (4 + (x->m_number_of_readers * 2)));
+    }
+
+    // we first need to store the (clipped) delay sizes because the inputs may be overriden by outputs.
+    for(i = 0; i < x->m_number_of_readers; ++i)
+    {
+        pa_ringbuffer_clip_delays(buffer, x->m_inputs[i], x->m_delay_sizes + i * vecsize, vecsize);
+    }
 
-        // increment then wrap counter between buffer boundaries
-        if(++x->m_writer_playhead >= x->m_buffersize) x->m_writer_playhead -= x->m_buffersize;
+    // write the whole block, the readers never read ahead of the sample they output
+    // and the headroom prevents the block from overwriting the oldest samples they need.
+    pa_ringbuffer_write_block(buffer, first_input, vecsize);
+
+    // then each reader processes the whole block, in address order.
+    sort_readers(x, vecsize);
+
+    for(i = 0; i < x->m_number_of_readers; ++i)
+    {
+        const int reader = x->m_order[i];
+        pa_ringbuffer_read_interp_block(buffer, x->m_interp, x->m_delay_sizes + reader * vecsize,
+                                        x->m_outputs[reader], vecsize, x->m_allpass_states + reader);
     }
 
     return (w + (4 + (x->m_number_of_readers * 2)));
@@ -154,6 +270,21 @@ static t_int* pa_delay5_tilde_perform(t_int *w)
 
 static void pa_delay5_tilde_dsp(t_pa_delay5_tilde *x, t_signal **sp)
 {
+    x->m_vecsize = sp[0]->s_n;
+
+    // the buffer is resized before the headroom is reserved
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+
+    // keep a block (and one sample) of headroom so that the perform method can write a whole block before reading it
+    if(pa_ringbuffer_reserve(&x->m_buffer, x->m_buffer.m_size + x->m_vecsize + 1))
+    {
+        pd_error((t_object*)x, "pa.delay5~: can't allocate the block headroom, processing samples one by one");
+    }
+
+    // one block of delay sizes per reader
+    free(x->m_delay_sizes);
+    x->m_delay_sizes = (t_sample*)malloc(sizeof(t_sample) * x->m_number_of_readers * sp[0]->s_n);
+
     x->m_dspvec[0] = (t_int)x;
     x->m_dspvec[1] = (t_int)sp[0]->s_n;
     x->m_dspvec[2] = (t_int)sp[0]->s_vec;
@@ -173,22 +304,22 @@ static void* pa_delay5_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
     if(x)
     {
-        x->m_buffer = NULL;
-        x->m_writer_playhead = 0;
         int ndelay = 1;
 
+        x->m_vecsize = sys_getblksize();
+
         t_int buffersize = sys_getsr() * 0.1; // default to 100ms
 
         // init buffersize
         if(argc >= 1 && argv->a_type == A_FLOAT)
         {
-            if(argv->a_w.w_float > 0)
+            if(pa_ringbuffer_isvalidsize(argv->a_w.w_float))
             {
                 buffersize = (t_int)argv->a_w.w_float;
             }
             else
             {
-                pd_error((t_object*)x, "buffer size must be > 1");
+                pd_error((t_object*)x, "pa.delay5~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
             }
         }
 
@@ -202,7 +333,6 @@ static void* pa_delay5_tilde_new(t_symbol *s, int argc, t_atom *argv)
             }
         }
 
-        x->m_buffersize = buffersize;
         x->m_number_of_readers = ndelay;
         
         // init inlets/outlets
@@ -221,13 +351,33 @@ static void* pa_delay5_tilde_new(t_symbol *s, int argc, t_atom *argv)
         x->m_outputs = (t_sample**)malloc(sizeof(t_sample*) * x->m_number_of_readers);
         
         x->m_delay_sizes = (t_sample*)malloc(sizeof(t_sample) * x->m_number_of_readers);
+
+        // one allpass interpolation state per reader
+        x->m_interp = PA_RINGBUFFER_INTERP_LINEAR;
+        x->m_allpass_states = (float*)calloc(x->m_number_of_readers, sizeof(float));
+
+        // readers are processed in the order of their mean delays (see sort_readers)
+        x->m_mean_delays = (float*)calloc(x->m_number_of_readers, sizeof(float));
+        x->m_order = (int*)malloc(sizeof(int) * x->m_number_of_readers);
+        for(i = 0; i < x->m_number_of_readers; i++)
+        {
+            x->m_order[i] = i;
+        }
         
         // init dsp vector
         // object + vecsize + default inlet + inlets + outlets
         x->m_dspvec = (t_int*)malloc(sizeof(t_int) * (3 + (x->m_number_of_readers * 2)));
 
-        // reset our buffer.
-        create_buffer(x);
+        // allocate our buffer with the headroom that the dsp method reserves.
+        if(pa_ringbuffer_init_headroom(&x->m_buffer, (int)buffersize, x->m_vecsize + 1))
+        {
+            pd_error((t_object*)x, "pa.delay5~: can't allocate a buffer of %d samples", (int)buffersize);
+        }
+
+        if(pa_ringbuffer_resizer_init(&x->m_resizer, &x->m_buffer, 1))
+        {
+            pd_error((t_object*)x, "pa.delay5~: can't allocate the resizer");
+        }
     }
 
     return (x);
@@ -252,10 +402,14 @@ static void pa_delay5_tilde_free(t_pa_delay5_tilde *x)
     free(x->m_inputs);
     free(x->m_outputs);
     free(x->m_delay_sizes);
+    free(x->m_allpass_states);
+    free(x->m_mean_delays);
+    free(x->m_order);
 
     free(x->m_dspvec);
 
-    delete_buffer(x);
+    pa_ringbuffer_resizer_free(&x->m_resizer);
+    pa_ringbuffer_free(&x->m_buffer);
 }
 
 extern void setup_pa0x2edelay5_tilde(void)
@@ -267,6 +421,9 @@ extern void setup_pa0x2edelay5_tilde(void)
     {
         class_addmethod(c, (t_method)pa_delay5_tilde_dsp, gensym("dsp"), A_CANT);
         class_addmethod(c, (t_method)clear_buffer, gensym("clear"), 0);
+        class_addmethod(c, (t_method)set_maxdelay, gensym("maxdelay"), A_FLOAT, 0);
+        class_addmethod(c, (t_method)set_interp, gensym("interp"), A_SYMBOL, 0);
+        class_addmethod(c, (t_method)post_stats, gensym("stats"), 0);
         CLASS_MAINSIGNALIN(c, t_pa_delay5_tilde, m_f);
     }
     pa_delay5_tilde_class = c;
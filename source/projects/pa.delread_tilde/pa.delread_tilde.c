@@ -0,0 +1,174 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A signal driven reader of a named delay line (written by pa.delwrite~).
+
+#include <m_pd.h>
+
+#include <stdlib.h> // malloc, free...
+
+#include <pa_delwrite.h>
+
+static t_class *pa_delread_tilde_class;
+
+typedef struct _pa_delread_tilde
+{
+    t_object    m_obj;
+    
+    t_symbol*               m_name;
+    t_pa_delwrite_tilde*    m_writer;       // resolved in the dsp method
+    int                     m_writer_first; // the writer runs before us in the dsp chain
+    
+    t_sample*   m_delays;       // a block of delay sizes (allocated in the dsp method)
+    int         m_interp;       // interpolation mode
+    float       m_allpass_state;
+    
+    t_outlet*   m_out;
+    
+    float       m_f;
+    
+} t_pa_delread_tilde;
+
+static void pa_delread_tilde_set_interp(t_pa_delread_tilde* x, t_symbol* s)
+{
+    const int mode = pa_ringbuffer_interp_from_name(s->s_name);
+    
+    if(mode < 0)
+    {
+        pd_error((t_object*)x, "pa.delread~: unknown interpolation %s (linear, hermite, lagrange or allpass)", s->s_name);
+        return;
+    }
+    
+    x->m_interp = mode;
+    x->m_allpass_state = 0.f;
+}
+
+static t_int *pa_delread_tilde_perform(t_int *w)
+{
+    t_pa_delread_tilde *x   = (t_pa_delread_tilde *)(w[1]);
+    t_sample  *in = (t_sample *)(w[2]);
+    t_sample  *out = (t_sample *)(w[3]);
+    int vecsize = (int)(w[4]);
+    
+    t_pa_delwrite_tilde* writer = x->m_writer;
+    
+    // the writer has no buffer if its allocation failed.
+    if(!writer->m_buffer.m_buffer)
+    {
+        int i;
+        for(i = 0; i < vecsize; ++i) out[i] = 0.f;
+        return (w+5);
+    }
+    
+    // the block functions of the ringbuffer expect the current block to be written,
+    // when we run before the writer we read it as if it was and we can't read less than one block of delay.
+    t_pa_ringbuffer buffer = writer->m_buffer;
+    float mindelay = 1.f;
+    
+    if(!x->m_writer_first)
+    {
+        buffer.m_writer = (buffer.m_writer + vecsize) & buffer.m_mask;
+        mindelay = vecsize + 1.f;
+    }
+    
+    // store the (clipped) delay sizes first because the output may override them
+    pa_ringbuffer_clip_delays_range(&buffer, mindelay, in, x->m_delays, vecsize);
+    pa_ringbuffer_read_interp_block(&buffer, x->m_interp, x->m_delays, out, vecsize, &x->m_allpass_state);
+    
+    return (w+5);
+}
+
+static t_int *pa_delread_tilde_perform_zero(t_int *w)
+{
+    t_sample  *out = (t_sample *)(w[1]);
+    int vecsize = (int)(w[2]);
+    
+    while(vecsize--) *out++ = 0.f;
+    
+    return (w+3);
+}
+
+static void pa_delread_tilde_dsp(t_pa_delread_tilde *x, t_signal **sp)
+{
+    // resolve the writer once per dsp build
+    x->m_writer = pa_delwrite_tilde_find(x->m_name);
+    
+    if(!x->m_writer)
+    {
+        pd_error((t_object*)x, "pa.delread~: %s: no such pa.delwrite~", x->m_name->s_name);
+    }
+    else if(x->m_writer->m_vecsize != sp[0]->s_n)
+    {
+        pd_error((t_object*)x, "pa.delread~: %s: block size differs from the pa.delwrite~ one", x->m_name->s_name);
+        x->m_writer = NULL;
+    }
+    
+    free(x->m_delays);
+    x->m_delays = (t_sample*)malloc(sizeof(t_sample) * sp[0]->s_n);
+    
+    if(!x->m_writer || !x->m_delays)
+    {
+        dsp_add(pa_delread_tilde_perform_zero, 2, sp[1]->s_vec, sp[0]->s_n);
+        return;
+    }
+    
+    x->m_writer_first = pa_delwrite_tilde_is_sorted_first(x->m_writer);
+    
+    dsp_add(pa_delread_tilde_perform, 4,
+            x,              // object
+            sp[0]->s_vec,   // inlet 1
+            sp[1]->s_vec,   // outlet 1
+            sp[0]->s_n);    // vectorsize
+}
+
+static void *pa_delread_tilde_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_pa_delread_tilde *x = (t_pa_delread_tilde *)pd_new(pa_delread_tilde_class);
+    
+    if(x)
+    {
+        x->m_name = &s_;
+        x->m_writer = NULL;
+        x->m_writer_first = 0;
+        x->m_delays = NULL;
+        x->m_interp = PA_RINGBUFFER_INTERP_LINEAR;
+        x->m_allpass_state = 0.f;
+        
+        if(argc >= 1 && argv->a_type == A_SYMBOL)
+        {
+            x->m_name = argv->a_w.w_symbol;
+        }
+        else
+        {
+            pd_error((t_object*)x, "pa.delread~: first argument must be the name of the delay line");
+        }
+        
+        // create one signal outlet:
+        x->m_out = outlet_new((t_object *)x, &s_signal);
+    }
+    
+    return (x);
+}
+
+static void pa_delread_tilde_free(t_pa_delread_tilde *x)
+{
+    free(x->m_delays);
+    outlet_free(x->m_out);
+}
+
+extern void setup_pa0x2edelread_tilde(void)
+{
+    t_class* c = class_new(gensym("pa.delread~"),
+                           (t_newmethod)pa_delread_tilde_new, (t_method)pa_delread_tilde_free,
+                           sizeof(t_pa_delread_tilde), CLASS_DEFAULT, A_GIMME, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_delread_tilde_dsp, gensym("dsp"), A_CANT);
+        class_addmethod(c, (t_method)pa_delread_tilde_set_interp, gensym("interp"), A_SYMBOL, 0);
+        CLASS_MAINSIGNALIN(c, t_pa_delread_tilde, m_f);
+    }
+    pa_delread_tilde_class = c;
+}
@@ -0,0 +1,158 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief The writer of a named delay line (read by any number of pa.delread~).
+
+#include <m_pd.h>
+
+#include <pa_delwrite.h>
+
+static t_class *pa_delwrite_tilde_class;
+
+static void pa_delwrite_tilde_clear_buffer(t_pa_delwrite_tilde* x)
+{
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    pa_ringbuffer_clear(&x->m_buffer);
+}
+
+//! @brief Change the buffer size (in samps), the most recent history is kept.
+//! @details The new buffer is allocated here, the history is copied by a worker thread and the buffers
+//! are swapped at the start of a block (see pa_ringbuffer_resizer.h). The readers use the buffer of the writer.
+static void pa_delwrite_tilde_set_maxdelay(t_pa_delwrite_tilde* x, t_floatarg f)
+{
+    if(!pa_ringbuffer_isvalidsize(f))
+    {
+        pd_error((t_object*)x, "pa.delwrite~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+        return;
+    }
+    
+    const int buffersize = (int)f;
+    
+    if(pa_ringbuffer_resizer_request(&x->m_resizer, buffersize, x->m_vecsize + 1))
+    {
+        pd_error((t_object*)x, "pa.delwrite~: can't allocate a buffer of %d samples", buffersize);
+    }
+}
+
+static t_int *pa_delwrite_tilde_perform(t_int *w)
+{
+    t_pa_delwrite_tilde *x   = (t_pa_delwrite_tilde *)(w[1]);
+    t_sample  *in = (t_sample *)(w[2]);
+    int vecsize = (int)(w[3]);
+    
+    // the readers that run after us see the resized buffer in this block, the others in the next one
+    pa_ringbuffer_resizer_swap(&x->m_resizer, vecsize);
+    
+    // the readers know when we write (see pa_delwrite_tilde_is_sorted_first())
+    pa_ringbuffer_write_block(&x->m_buffer, in, vecsize);
+    
+    return (w+4);
+}
+
+static void pa_delwrite_tilde_dsp(t_pa_delwrite_tilde *x, t_signal **sp)
+{
+    x->m_vecsize = sp[0]->s_n;
+    x->m_sortno = ugen_getsortno();
+    
+    // the buffer is resized before the headroom is reserved
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+    
+    // keep a block (and one sample) of headroom for the 4-point interpolations of the readers
+    if(pa_ringbuffer_reserve(&x->m_buffer, x->m_buffer.m_size + x->m_vecsize + 1))
+    {
+        pd_error((t_object*)x, "pa.delwrite~: can't allocate the block headroom");
+        return;
+    }
+    
+    dsp_add(pa_delwrite_tilde_perform, 3,
+            x,              // object
+            sp[0]->s_vec,   // inlet 1
+            sp[0]->s_n);    // vectorsize
+}
+
+static void *pa_delwrite_tilde_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_pa_delwrite_tilde *x = (t_pa_delwrite_tilde *)pd_new(pa_delwrite_tilde_class);
+    
+    if(x)
+    {
+        x->m_name = &s_;
+        x->m_vecsize = sys_getblksize();
+        x->m_sortno = -1;
+        
+        int buffersize = sys_getsr() * 0.1; // default to 100ms
+        
+        if(argc >= 1 && argv->a_type == A_SYMBOL)
+        {
+            x->m_name = argv->a_w.w_symbol;
+        }
+        else
+        {
+            pd_error((t_object*)x, "pa.delwrite~: first argument must be the name of the delay line");
+        }
+        
+        if(argc >= 2 && (argv+1)->a_type == A_FLOAT)
+        {
+            if(pa_ringbuffer_isvalidsize((argv+1)->a_w.w_float))
+            {
+                buffersize = (int)(argv+1)->a_w.w_float;
+            }
+            else
+            {
+                pd_error((t_object*)x, "pa.delwrite~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+            }
+        }
+        
+        // allocate our buffer with the headroom that the dsp method reserves.
+        if(pa_ringbuffer_init_headroom(&x->m_buffer, buffersize, x->m_vecsize + 1))
+        {
+            pd_error((t_object*)x, "pa.delwrite~: can't allocate a buffer of %d samples", buffersize);
+        }
+        
+        if(pa_ringbuffer_resizer_init(&x->m_resizer, &x->m_buffer, 1))
+        {
+            pd_error((t_object*)x, "pa.delwrite~: can't allocate the resizer");
+        }
+        
+        if(x->m_name != &s_)
+        {
+            if(pa_delwrite_tilde_find(x->m_name))
+            {
+                pd_error((t_object*)x, "pa.delwrite~: %s: multiply defined", x->m_name->s_name);
+            }
+            
+            pd_bind(&x->m_obj.ob_pd, x->m_name);
+        }
+    }
+    
+    return (x);
+}
+
+static void pa_delwrite_tilde_free(t_pa_delwrite_tilde *x)
+{
+    if(x->m_name != &s_)
+    {
+        pd_unbind(&x->m_obj.ob_pd, x->m_name);
+    }
+    
+    pa_ringbuffer_resizer_free(&x->m_resizer);
+    pa_ringbuffer_free(&x->m_buffer);
+}
+
+extern void setup_pa0x2edelwrite_tilde(void)
+{
+    t_class* c = class_new(gensym(PA_DELWRITE_CLASS_NAME),
+                           (t_newmethod)pa_delwrite_tilde_new, (t_method)pa_delwrite_tilde_free,
+                           sizeof(t_pa_delwrite_tilde), CLASS_DEFAULT, A_GIMME, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_delwrite_tilde_dsp, gensym("dsp"), A_CANT);
+        class_addmethod(c, (t_method)pa_delwrite_tilde_clear_buffer, gensym("clear"), 0);
+        class_addmethod(c, (t_method)pa_delwrite_tilde_set_maxdelay, gensym("maxdelay"), A_FLOAT, 0);
+        CLASS_MAINSIGNALIN(c, t_pa_delwrite_tilde, m_f);
+    }
+    pa_delwrite_tilde_class = c;
+}
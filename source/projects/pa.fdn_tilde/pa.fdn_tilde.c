@@ -0,0 +1,449 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A feedback delay network.
+//! @details N delay lines are fed by the input and by their own outputs through a
+//! Householder or Hadamard matrix. The feedback is computed inside the object,
+//! so the loop delay is the delay of each line and not a whole block as with Pd connections.
+
+#include <m_pd.h>
+
+#include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // strcmp
+#include <math.h>   // sqrtf, powf
+
+#include <pa_ringbuffer_resizer.h>
+
+#define PA_FDN_MAX_LINES 64
+
+enum
+{
+    PA_FDN_MATRIX_HOUSEHOLDER = 0,
+    PA_FDN_MATRIX_HADAMARD
+};
+
+static t_class *pa_fdn_tilde_class;
+
+typedef struct _pa_fdn_tilde
+{
+    t_object    m_obj;
+
+    int         m_number_of_lines;
+    int         m_size;         // maximum delay (in samps), the lines may not be resized yet
+    t_pa_ringbuffer* m_lines;   // one ringbuffer per line, all the writers move together
+    t_pa_ringbuffer_resizer m_resizer;  // resizes the lines while the dsp runs (see maxdelay)
+    int*        m_delays;       // delay of each line (in samps)
+    int         m_mindelay;     // shortest delay, the length of the chunks processed at once
+    float       m_feedback;
+    int         m_matrix;
+
+    t_sample*   m_input;        // a copy of the input block (the outputs may overwrite it)
+    t_sample*   m_outputs;      // a chunk of outputs for each line (lines * block size)
+    t_sample*   m_sum;          // sum of the outputs of all lines for each sample of a chunk
+
+    t_outlet*   m_left;
+    t_outlet*   m_right;
+
+    float       m_f;
+
+} t_pa_fdn_tilde;
+
+static void pa_fdn_tilde_update_mindelay(t_pa_fdn_tilde* x)
+{
+    int i;
+    x->m_mindelay = x->m_size;
+
+    for(i = 0; i < x->m_number_of_lines; ++i)
+    {
+        if(x->m_delays[i] < x->m_mindelay) x->m_mindelay = x->m_delays[i];
+    }
+}
+
+//! @brief Set the delay of a line, clipped between 1 samp and the buffer size.
+static void pa_fdn_tilde_set_line_delay(t_pa_fdn_tilde* x, int line, float delay)
+{
+    int idelay = (int)delay;
+    if(idelay < 1) idelay = 1;
+    if(idelay > x->m_size) idelay = x->m_size;
+    x->m_delays[line] = idelay;
+}
+
+//! @brief Spread the delays between the buffer size and half of it, on a geometric scale.
+static void pa_fdn_tilde_default_delays(t_pa_fdn_tilde* x)
+{
+    int i;
+    for(i = 0; i < x->m_number_of_lines; ++i)
+    {
+        pa_fdn_tilde_set_line_delay(x, i, x->m_size * powf(0.5f, (float)i / x->m_number_of_lines) - i);
+    }
+
+    pa_fdn_tilde_update_mindelay(x);
+}
+
+static void pa_fdn_tilde_set_delays(t_pa_fdn_tilde* x, t_symbol* s, int argc, t_atom* argv)
+{
+    int i;
+    for(i = 0; i < argc && i < x->m_number_of_lines; ++i)
+    {
+        pa_fdn_tilde_set_line_delay(x, i, atom_getfloat(argv + i));
+    }
+
+    pa_fdn_tilde_update_mindelay(x);
+}
+
+static void pa_fdn_tilde_set_feedback(t_pa_fdn_tilde* x, t_floatarg f)
+{
+    if(f > 1.f) f = 1.f;
+    if(f < -1.f) f = -1.f;
+    x->m_feedback = f;
+}
+
+static void pa_fdn_tilde_set_matrix(t_pa_fdn_tilde* x, t_symbol* s)
+{
+    const int nlines = x->m_number_of_lines;
+
+    if(strcmp(s->s_name, "householder") == 0)
+    {
+        x->m_matrix = PA_FDN_MATRIX_HOUSEHOLDER;
+    }
+    else if(strcmp(s->s_name, "hadamard") == 0)
+    {
+        if(nlines & (nlines - 1))
+        {
+            pd_error((t_object*)x, "pa.fdn~: the hadamard matrix needs a power of two number of lines");
+            return;
+        }
+
+        x->m_matrix = PA_FDN_MATRIX_HADAMARD;
+    }
+    else
+    {
+        pd_error((t_object*)x, "pa.fdn~: unknown matrix %s (householder or hadamard)", s->s_name);
+    }
+}
+
+static void pa_fdn_tilde_clear(t_pa_fdn_tilde* x)
+{
+    int i;
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+
+    for(i = 0; i < x->m_number_of_lines; ++i)
+    {
+        pa_ringbuffer_clear(x->m_lines + i);
+    }
+}
+
+//! @brief Change the buffer size (in samps) of all lines, the most recent history is kept.
+//! @details The delays are clipped to the new size. The new buffers are allocated here, the history is copied
+//! by a worker thread and the lines are swapped together at the start of a block (see pa_ringbuffer_resizer.h).
+static void pa_fdn_tilde_set_maxdelay(t_pa_fdn_tilde* x, t_floatarg f)
+{
+    int i;
+
+    if(!pa_ringbuffer_isvalidsize(f))
+    {
+        pd_error((t_object*)x, "pa.fdn~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+        return;
+    }
+
+    const int buffersize = (int)f;
+
+    if(pa_ringbuffer_resizer_request(&x->m_resizer, buffersize, 0))
+    {
+        pd_error((t_object*)x, "pa.fdn~: can't allocate a buffer of %d samples", buffersize);
+        return;
+    }
+
+    x->m_size = buffersize;
+
+    for(i = 0; i < x->m_number_of_lines; ++i)
+    {
+        pa_fdn_tilde_set_line_delay(x, i, x->m_delays[i]);
+    }
+
+    pa_fdn_tilde_update_mindelay(x);
+}
+
+//! @brief In place fast Walsh-Hadamard transform of the outputs, normalized to keep the energy.
+//! @details The butterflies run across the lines, the inner loops run along the samples of the chunk
+//! so that they can be vectorized.
+static void pa_fdn_tilde_hadamard(t_sample* outputs, int nlines, int stride, int n)
+{
+    const float scale = 1.f / sqrtf((float)nlines);
+    int h, i, j, k;
+
+    for(h = 1; h < nlines; h <<= 1)
+    {
+        for(i = 0; i < nlines; i += (h << 1))
+        {
+            for(j = i; j < i + h; ++j)
+            {
+                t_sample* PA_RESTRICT a = outputs + j * stride;
+                t_sample* PA_RESTRICT b = outputs + (j + h) * stride;
+
+                for(k = 0; k < n; ++k)
+                {
+                    const float u = a[k];
+                    const float v = b[k];
+                    a[k] = u + v;
+                    b[k] = u - v;
+                }
+            }
+        }
+    }
+
+    for(j = 0; j < nlines; ++j)
+    {
+        t_sample* PA_RESTRICT line = outputs + j * stride;
+        for(k = 0; k < n; ++k)
+        {
+            line[k] *= scale;
+        }
+    }
+}
+
+//! @brief Process n samples, n must not be greater than the shortest delay.
+//! @details All the samples the lines output during the chunk were written before it,
+//! so each line reads its chunk in one go, the matrix is applied to the whole chunk,
+//! then each line writes its chunk in one go.
+static void pa_fdn_tilde_process_chunk(t_pa_fdn_tilde* x, t_sample const* PA_RESTRICT in,
+                                       t_sample* PA_RESTRICT left, t_sample* PA_RESTRICT right,
+                                       int stride, int n)
+{
+    const int nlines = x->m_number_of_lines;
+    const float gain = 1.f / sqrtf((float)nlines);
+    const float feedback = x->m_feedback;
+    const int size = x->m_lines->m_size;
+    t_sample* PA_RESTRICT sum = x->m_sum;
+    int i, j;
+
+    for(i = 0; i < n; ++i)
+    {
+        left[i] = right[i] = sum[i] = 0.f;
+    }
+
+    // read the chunk of each line, the even lines go to the left outlet and the odd ones to the right one
+    for(j = 0; j < nlines; ++j)
+    {
+        t_sample* PA_RESTRICT line = x->m_outputs + j * stride;
+        t_sample* PA_RESTRICT out = (j & 1) ? right : left;
+
+        // the delays are clipped to the lines until they are resized
+        const int delay = (x->m_delays[j] < size) ? x->m_delays[j] : size;
+        pa_ringbuffer_read_block(x->m_lines + j, delay - n, line, n);
+
+        for(i = 0; i < n; ++i)
+        {
+            out[i] += line[i] * gain;
+            sum[i] += line[i];
+        }
+    }
+
+    // mix the outputs through the feedback matrix
+    if(x->m_matrix == PA_FDN_MATRIX_HADAMARD)
+    {
+        pa_fdn_tilde_hadamard(x->m_outputs, nlines, stride, n);
+    }
+    else
+    {
+        // Householder reflection: I - 2/N * ones
+        const float reflect = 2.f / nlines;
+
+        for(j = 0; j < nlines; ++j)
+        {
+            t_sample* PA_RESTRICT line = x->m_outputs + j * stride;
+            for(i = 0; i < n; ++i)
+            {
+                line[i] -= reflect * sum[i];
+            }
+        }
+    }
+
+    // feed the lines with the input and the mixed outputs
+    for(j = 0; j < nlines; ++j)
+    {
+        t_sample* PA_RESTRICT line = x->m_outputs + j * stride;
+        for(i = 0; i < n; ++i)
+        {
+            line[i] = in[i] + feedback * line[i];
+        }
+
+        pa_ringbuffer_write_block(x->m_lines + j, line, n);
+    }
+}
+
+static t_int* pa_fdn_tilde_perform(t_int *w)
+{
+    t_pa_fdn_tilde* x = (t_pa_fdn_tilde *)(w[1]);
+    t_sample const* in = (t_sample *)(w[2]);
+    t_sample* left = (t_sample *)(w[3]);
+    t_sample* right = (t_sample *)(w[4]);
+    int vecsize = (int)(w[5]);
+    int offset = 0;
+
+    pa_ringbuffer_resizer_swap(&x->m_resizer, vecsize);
+
+    const int mindelay = (x->m_mindelay < x->m_lines->m_size) ? x->m_mindelay : x->m_lines->m_size;
+
+    memcpy(x->m_input, in, sizeof(t_sample) * vecsize);
+
+    // delays shorter than the block are processed in chunks of the shortest delay
+    while(offset < vecsize)
+    {
+        const int n = (vecsize - offset < mindelay) ? (vecsize - offset) : mindelay;
+        pa_fdn_tilde_process_chunk(x, x->m_input + offset, left + offset, right + offset, vecsize, n);
+        offset += n;
+    }
+
+    return (w+6);
+}
+
+static t_int* pa_fdn_tilde_perform_zero(t_int *w)
+{
+    t_sample* left = (t_sample *)(w[1]);
+    t_sample* right = (t_sample *)(w[2]);
+    int vecsize = (int)(w[3]);
+
+    memset(left, 0, sizeof(t_sample) * vecsize);
+    memset(right, 0, sizeof(t_sample) * vecsize);
+    return (w+4);
+}
+
+static void pa_fdn_tilde_dsp(t_pa_fdn_tilde *x, t_signal **sp)
+{
+    const int vecsize = sp[0]->s_n;
+    int allocated = 1;
+    int i;
+
+    pa_ringbuffer_resizer_finish(&x->m_resizer);
+
+    for(i = 0; i < x->m_number_of_lines; ++i)
+    {
+        allocated = allocated && x->m_lines[i].m_buffer;
+    }
+
+    free(x->m_input);
+    free(x->m_outputs);
+    free(x->m_sum);
+    x->m_input = (t_sample*)malloc(sizeof(t_sample) * vecsize);
+    x->m_outputs = (t_sample*)malloc(sizeof(t_sample) * vecsize * x->m_number_of_lines);
+    x->m_sum = (t_sample*)malloc(sizeof(t_sample) * vecsize);
+
+    if(!allocated || !x->m_input || !x->m_outputs || !x->m_sum)
+    {
+        pd_error((t_object*)x, "pa.fdn~: can't allocate the buffers");
+        dsp_add(pa_fdn_tilde_perform_zero, 3, sp[1]->s_vec, sp[2]->s_vec, vecsize);
+        return;
+    }
+
+    dsp_add(pa_fdn_tilde_perform, 5,
+            x,              // object
+            sp[0]->s_vec,   // inlet 1
+            sp[1]->s_vec,   // outlet 1
+            sp[2]->s_vec,   // outlet 2
+            vecsize);       // vectorsize
+}
+
+static void* pa_fdn_tilde_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_pa_fdn_tilde *x = (t_pa_fdn_tilde *)pd_new(pa_fdn_tilde_class);
+
+    if(x)
+    {
+        int nlines = 8;
+        int buffersize = sys_getsr() * 0.1; // default to 100ms
+        int i;
+
+        // init number of lines
+        if(argc >= 1 && argv->a_type == A_FLOAT)
+        {
+            nlines = (int)argv->a_w.w_float;
+            if(nlines < 1) nlines = 1;
+            if(nlines > PA_FDN_MAX_LINES) nlines = PA_FDN_MAX_LINES;
+        }
+
+        // init buffersize
+        if(argc >= 2 && (argv+1)->a_type == A_FLOAT)
+        {
+            if(pa_ringbuffer_isvalidsize((argv+1)->a_w.w_float))
+            {
+                buffersize = (int)(argv+1)->a_w.w_float;
+            }
+            else
+            {
+                pd_error((t_object*)x, "pa.fdn~: buffer size must be between 1 and %d samples", PA_RINGBUFFER_MAX_SIZE);
+            }
+        }
+
+        x->m_number_of_lines = nlines;
+        x->m_size = buffersize;
+        x->m_feedback = 0.f;
+        x->m_matrix = PA_FDN_MATRIX_HOUSEHOLDER;
+        x->m_input = x->m_outputs = x->m_sum = NULL;
+
+        x->m_lines = (t_pa_ringbuffer*)calloc(nlines, sizeof(t_pa_ringbuffer));
+        x->m_delays = (int*)malloc(sizeof(int) * nlines);
+
+        for(i = 0; i < nlines; ++i)
+        {
+            if(pa_ringbuffer_init(x->m_lines + i, buffersize))
+            {
+                pd_error((t_object*)x, "pa.fdn~: can't allocate a buffer of %d samples", buffersize);
+                break;
+            }
+        }
+
+        if(pa_ringbuffer_resizer_init(&x->m_resizer, x->m_lines, nlines))
+        {
+            pd_error((t_object*)x, "pa.fdn~: can't allocate the resizer");
+        }
+
+        pa_fdn_tilde_default_delays(x);
+
+        x->m_left = outlet_new((t_object *)x, &s_signal);
+        x->m_right = outlet_new((t_object *)x, &s_signal);
+    }
+
+    return (x);
+}
+
+static void pa_fdn_tilde_free(t_pa_fdn_tilde *x)
+{
+    int i;
+    pa_ringbuffer_resizer_free(&x->m_resizer);
+
+    for(i = 0; i < x->m_number_of_lines; ++i)
+    {
+        pa_ringbuffer_free(x->m_lines + i);
+    }
+
+    free(x->m_lines);
+    free(x->m_delays);
+    free(x->m_input);
+    free(x->m_outputs);
+    free(x->m_sum);
+
+    outlet_free(x->m_left);
+    outlet_free(x->m_right);
+}
+
+extern void setup_pa0x2efdn_tilde(void)
+{
+    t_class* c = class_new(gensym("pa.fdn~"),
+                           (t_newmethod)pa_fdn_tilde_new, (t_method)pa_fdn_tilde_free,
+                           sizeof(t_pa_fdn_tilde), CLASS_DEFAULT, A_GIMME, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_fdn_tilde_dsp, gensym("dsp"), A_CANT);
+        class_addmethod(c, (t_method)pa_fdn_tilde_clear, gensym("clear"), 0);
+        class_addmethod(c, (t_method)pa_fdn_tilde_set_maxdelay, gensym("maxdelay"), A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_fdn_tilde_set_delays, gensym("delays"), A_GIMME, 0);
+        class_addmethod(c, (t_method)pa_fdn_tilde_set_feedback, gensym("feedback"), A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_fdn_tilde_set_matrix, gensym("matrix"), A_SYMBOL, 0);
+        CLASS_MAINSIGNALIN(c, t_pa_fdn_tilde, m_f);
+    }
+    pa_fdn_tilde_class = c;
+}
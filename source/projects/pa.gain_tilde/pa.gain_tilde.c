@@ -2,10 +2,28 @@
 // For information on usage and redistribution, and for a DISCLAIMER OF ALL
 // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
 
-//! @brief Multiply signal with a smooth transition.
+//! @brief Multiply signals with a smooth transition.
+//! @details The creation argument sets the number of channels, they all share the same gain :
+//! the gains of a block are computed once in a vector (only when a ramp or a message falls in it),
+//! then each channel is multiplied by this vector. The gain messages are timestamped with the logical time at which they are received
+//! and queued, the perform routine starts each ramp at the sample matching its timestamp (like vline~),
+//! so the automation doesn't depend on the block size.
 
 #include <m_pd.h>
 #include <math.h>
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset, memcpy
+
+//! @brief Maximum number of gain messages waiting for their block.
+#define PA_GAIN_QUEUE_SIZE 64
+
+typedef struct _pa_gain_event
+{
+    double      m_time;         // logical time of the message (in ms, relative to the reference time)
+    float       m_gain;
+    float       m_ramp_time;    // in ms
+
+} t_pa_gain_event;
 
 static t_class *pa_gain_tilde_class;
 
@@ -18,57 +36,257 @@ typedef struct _pa_gain_tilde
     float       m_gain_increment;
     int         m_samps_to_fade;
 
+    // the messages not applied yet, in the order they were received (a ring of preallocated events)
+    t_pa_gain_event m_queue[PA_GAIN_QUEUE_SIZE];
+    int         m_queue_head;
+    int         m_queue_count;
+    double      m_reftime;      // the logical time the timestamps are relative to
+    float       m_sr;
+
+    // the channels
+    int         m_channels;
+    t_inlet**   m_inlets;
+    t_outlet**  m_outlets;
+    t_sample**  m_inputs;
+    t_sample**  m_outputs;
+    t_int*      m_dspvec;
+
+    // one block of gains, shared by the channels
+    t_sample*   m_gains;
+
+    // a copy of the inputs, when an output overrides the input of another channel
+    int         m_copy_inputs;
+    t_sample*   m_input_copies;
+
     t_float     m_f;
 
 } t_pa_gain_tilde;
 
-static void pa_gain_tilde_set_gain(t_pa_gain_tilde *x, float new_gain, float ramp_time_ms)
+//! @brief Start a ramp to a new gain from the current one, called from the perform routine.
+static void pa_gain_tilde_start_ramp(t_pa_gain_tilde *x, float new_gain, float ramp_time_ms)
 {
     // gain should be positive
     x->m_gain_to = (new_gain > 0.) ? new_gain : 0.;
 
     // if the ramp time is positive then calculate the number of samples needed to smooth gain
-    x->m_samps_to_fade = (ramp_time_ms > 0) ? (int)(sys_getsr() * 0.001 * ramp_time_ms) : 0;
+    x->m_samps_to_fade = (ramp_time_ms > 0) ? (int)(x->m_sr * 0.001 * ramp_time_ms) : 0;
 
     // compute gain increment for each samples
     x->m_gain_increment = (x->m_samps_to_fade > 0) ? (x->m_gain_to - x->m_gain) / (float)x->m_samps_to_fade : 0;
 }
 
+//! @brief Queue a new gain, it is applied at the sample matching the current logical time.
+static void pa_gain_tilde_set_gain(t_pa_gain_tilde *x, float new_gain, float ramp_time_ms)
+{
+    t_pa_gain_event* event;
+
+    if(x->m_queue_count < PA_GAIN_QUEUE_SIZE)
+    {
+        event = x->m_queue + (x->m_queue_head + x->m_queue_count) % PA_GAIN_QUEUE_SIZE;
+        x->m_queue_count++;
+    }
+    else
+    {
+        // the queue is full (the dsp is probably off), the last message is replaced
+        event = x->m_queue + (x->m_queue_head + x->m_queue_count - 1) % PA_GAIN_QUEUE_SIZE;
+    }
+
+    event->m_time = clock_gettimesince(x->m_reftime);
+    event->m_gain = new_gain;
+    event->m_ramp_time = ramp_time_ms;
+}
+
+//! @brief Compute the gains of a part of the block from the current ramp and gain.
+static void pa_gain_tilde_compute_gains(t_pa_gain_tilde *x, t_sample *gains, int vecsize)
+{
+    int i = 0;
+
+    // ramp segment : the gain of each sample is computed from the start of the segment,
+    // so there is no dependency between the samples and the loop can be vectorized.
+    if(x->m_samps_to_fade > 0)
+    {
+        const int ramp = (x->m_samps_to_fade < vecsize) ? x->m_samps_to_fade : vecsize;
+        const float gain = x->m_gain;
+        const float increment = x->m_gain_increment;
+
+        for(; i < ramp; ++i)
+        {
+            gains[i] = gain + increment * (float)(i + 1);
+        }
+
+        x->m_samps_to_fade -= ramp;
+        x->m_gain = (x->m_samps_to_fade > 0) ? gain + increment * (float)ramp : x->m_gain_to;
+    }
+
+    // steady segment
+    if(i < vecsize)
+    {
+        const float gain = x->m_gain_to;
+        x->m_gain = gain;
+
+        for(; i < vecsize; ++i)
+        {
+            gains[i] = gain;
+        }
+    }
+}
+
+//! @brief Multiply a channel by a constant gain.
+static void pa_gain_tilde_apply_steady(float gain, t_sample const* in, t_sample *out, int vecsize)
+{
+    int i;
+
+    if(gain == 0.f)
+    {
+        memset(out, 0, sizeof(t_sample) * vecsize);
+    }
+    else if(gain == 1.f)
+    {
+        // the input and the output are the same vector or don't overlap
+        if(out != in) memcpy(out, in, sizeof(t_sample) * vecsize);
+    }
+    else
+    {
+        for(i = 0; i < vecsize; ++i)
+        {
+            out[i] = in[i] * gain;
+        }
+    }
+}
+
 static t_int *pa_gain_tilde_dsp_perform(t_int *w)
 {
     t_pa_gain_tilde   *x   = (t_pa_gain_tilde *)(w[1]);
-    t_sample  *in = (t_sample *)(w[2]);
-    t_sample  *out = (t_sample *)(w[3]);
-    int vecsize = (int)(w[4]);
+    int vecsize = (int)(w[2]);
+    t_sample* gains = x->m_gains;
+    double mspersamp = 0., blockstart = 0.;
+    int changing = (x->m_samps_to_fade > 0);
+    int i = 0, c;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        x->m_inputs[c] = (t_sample *)(w[c + 3]);
+        x->m_outputs[c] = (t_sample *)(w[c + 3 + x->m_channels]);
+    }
 
-    while(vecsize--)
+    // the outputs may override the inputs of the next channels
+    if(x->m_copy_inputs)
     {
-        if(x->m_samps_to_fade > 0)
+        for(c = 0; c < x->m_channels; ++c)
         {
-            x->m_gain += x->m_gain_increment;
-            x->m_samps_to_fade--;
+            t_sample* copy = x->m_input_copies + c * vecsize;
+            memcpy(copy, x->m_inputs[c], sizeof(t_sample) * vecsize);
+            x->m_inputs[c] = copy;
         }
-        else
+    }
+
+    if(x->m_queue_count > 0)
+    {
+        // the block ends at the current logical time
+        mspersamp = 1000. / x->m_sr;
+        blockstart = clock_gettimesince(x->m_reftime) - vecsize * mspersamp;
+
+        if((x->m_queue[x->m_queue_head].m_time - blockstart) / mspersamp < vecsize) changing = 1;
+    }
+
+    // the gain doesn't change during the block
+    if(!changing)
+    {
+        x->m_gain = x->m_gain_to;
+
+        for(c = 0; c < x->m_channels; ++c)
         {
-            x->m_gain = x->m_gain_to;
+            pa_gain_tilde_apply_steady(x->m_gain_to, x->m_inputs[c], x->m_outputs[c], vecsize);
         }
 
-        *out++ = *in++ * x->m_gain;
+        return (w + (3 + x->m_channels * 2));
+    }
+
+    // compute the gains of the block in segments between the messages received during it
+    while(x->m_queue_count > 0)
+    {
+        t_pa_gain_event const* event = x->m_queue + x->m_queue_head;
+        const double position = (event->m_time - blockstart) / mspersamp;
+        int onset;
+
+        if(position >= vecsize) break;
+
+        // the messages received before the block are late, they are applied at its start
+        onset = (position > i) ? (int)position : i;
+
+        pa_gain_tilde_compute_gains(x, gains + i, onset - i);
+        pa_gain_tilde_start_ramp(x, event->m_gain, event->m_ramp_time);
+        i = onset;
+
+        x->m_queue_head = (x->m_queue_head + 1) % PA_GAIN_QUEUE_SIZE;
+        x->m_queue_count--;
     }
 
-    return (w+5);
+    pa_gain_tilde_compute_gains(x, gains + i, vecsize - i);
+
+    // then all the channels are multiplied by the same gains
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        t_sample const* in = x->m_inputs[c];
+        t_sample* out = x->m_outputs[c];
+
+        for(i = 0; i < vecsize; ++i)
+        {
+            out[i] = in[i] * gains[i];
+        }
+    }
+
+    return (w + (3 + x->m_channels * 2));
 }
 
 static void pa_gain_tilde_dsp_prepare(t_pa_gain_tilde *x, t_signal **sp)
 {
+    x->m_sr = sp[0]->s_sr;
+
+    // the messages received while the dsp was off are applied now, the last one wins
+    if(x->m_queue_count > 0)
+    {
+        x->m_gain_to = x->m_queue[(x->m_queue_head + x->m_queue_count - 1) % PA_GAIN_QUEUE_SIZE].m_gain;
+        x->m_queue_head = x->m_queue_count = 0;
+    }
+
     // reset gain
-    pa_gain_tilde_set_gain(x, x->m_gain_to, 0.);
+    pa_gain_tilde_start_ramp(x, x->m_gain_to, 0.);
+
+    // one block of gains and of inputs
+    const int vecsize = sp[0]->s_n;
+    int i, j;
 
-    dsp_add(pa_gain_tilde_dsp_perform, 4,
-            x,
-            sp[0]->s_vec,
-            sp[1]->s_vec,
-            sp[0]->s_n);
+    free(x->m_gains);
+    free(x->m_input_copies);
+    x->m_gains = (t_sample*)malloc(sizeof(t_sample) * vecsize);
+    x->m_input_copies = (t_sample*)malloc(sizeof(t_sample) * vecsize * x->m_channels);
+
+    if(!x->m_gains || !x->m_input_copies)
+    {
+        pd_error((t_object*)x, "pa.gain~: can't allocate the block buffers");
+        return;
+    }
+
+    // Pd may give the output of a channel the vector of another one's input
+    x->m_copy_inputs = 0;
+    for(i = 0; i < x->m_channels; ++i)
+    {
+        for(j = 0; j < x->m_channels; ++j)
+        {
+            if(i != j && sp[x->m_channels + i]->s_vec == sp[j]->s_vec) x->m_copy_inputs = 1;
+        }
+    }
+
+    x->m_dspvec[0] = (t_int)x;
+    x->m_dspvec[1] = (t_int)vecsize;
+
+    for(i = 0; i < (x->m_channels * 2); ++i)
+    {
+        x->m_dspvec[2 + i] = (t_int)sp[i]->s_vec;
+    }
+
+    dsp_addv(pa_gain_tilde_dsp_perform, (2 + (x->m_channels * 2)), x->m_dspvec);
 }
 
 static void *pa_gain_tilde_new(t_symbol *s, int argc, t_atom *argv)
@@ -79,7 +297,39 @@ static void *pa_gain_tilde_new(t_symbol *s, int argc, t_atom *argv)
         x->m_gain = x->m_gain_to = x->m_gain_increment = 0.f;
         x->m_samps_to_fade = 0;
 
-        outlet_new((t_object *)x, &s_signal);
+        x->m_queue_head = x->m_queue_count = 0;
+        x->m_reftime = clock_getlogicaltime();
+        x->m_sr = sys_getsr();
+
+        // init number of channels
+        int channels = 1;
+        if(argc >= 1 && argv->a_type == A_FLOAT && argv->a_w.w_float > 1)
+        {
+            channels = (int)argv->a_w.w_float;
+        }
+
+        x->m_channels = channels;
+
+        // init inlets/outlets, the first inlet is the main signal inlet
+        x->m_inlets = (t_inlet**)malloc(sizeof(t_inlet*) * x->m_channels);
+        x->m_outlets = (t_outlet**)malloc(sizeof(t_outlet*) * x->m_channels);
+
+        int i = 0;
+        for(; i < x->m_channels; i++)
+        {
+            x->m_inlets[i] = (i > 0) ? signalinlet_new((t_object*)x, 0.f) : NULL;
+            x->m_outlets[i] = outlet_new((t_object *)x, &s_signal);
+        }
+
+        // init inputs/outputs
+        x->m_inputs = (t_sample**)malloc(sizeof(t_sample*) * x->m_channels);
+        x->m_outputs = (t_sample**)malloc(sizeof(t_sample*) * x->m_channels);
+        x->m_gains = NULL;
+        x->m_input_copies = NULL;
+        x->m_copy_inputs = 0;
+
+        // init dsp vector : object + vecsize + inputs + outputs
+        x->m_dspvec = (t_int*)malloc(sizeof(t_int) * (2 + x->m_channels * 2));
     }
 
     return (x);
@@ -87,7 +337,20 @@ static void *pa_gain_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
 static void pa_gain_tilde_free(t_pa_gain_tilde *x)
 {
-    ;
+    int i = 0;
+    for(; i < x->m_channels; i++)
+    {
+        if(x->m_inlets[i]) inlet_free(x->m_inlets[i]);
+        outlet_free(x->m_outlets[i]);
+    }
+
+    free(x->m_inlets);
+    free(x->m_outlets);
+    free(x->m_inputs);
+    free(x->m_outputs);
+    free(x->m_dspvec);
+    free(x->m_gains);
+    free(x->m_input_copies);
 }
 
 extern void setup_pa0x2egain_tilde(void)
@@ -0,0 +1,395 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A granular player reading a Pd array (or a pa.mmapsource).
+//! @details A grain starts each time the trigger signal rises above 0 (like pa.sah~), at the position
+//! and speed of the other inlets at that sample. The grains are stored as one array per parameter
+//! (one entry per grain) and each one is rendered for a whole block: the positions, the interpolation
+//! and the windowing are separate loops over the block, so that the compiler can vectorize them.
+//! Many grains in one object cost much less than as many pa.readbuffer2~ objects and windows.
+
+#include <m_pd.h>
+
+#include <stdlib.h> // malloc, free...
+#include <string.h> // memset
+#include <math.h>   // floor
+
+#include <pa_array.h>
+
+// number of terms of the polynomial of the window
+#define PA_GRANULAR_WINDOW_TERMS 9
+
+#define PA_GRANULAR_DEFAULT_GRAINS 512
+#define PA_GRANULAR_DEFAULT_DURATION 50.f
+
+//! @brief The Hann window as a polynomial of v = (t - 0.5)^2, t being the position in the window (0. to 1.).
+//! @details hann(t) = (1 + cos(2pi (t - 0.5))) / 2, the Taylor series of the cosine only has even powers of (t - 0.5).
+//! With 9 terms the error is below 2e-7. Unlike a table lookup, the polynomial can be vectorized.
+static float pa_granular_window_coefs[PA_GRANULAR_WINDOW_TERMS];
+
+static t_class* pa_granular_tilde_class;
+
+typedef struct _pa_granular_tilde
+{
+    t_object    m_obj;
+
+    t_pa_array  m_array;
+
+    // the grains, the active ones are the first m_active entries of each array
+    int         m_maxgrains;
+    int         m_active;
+    double*     m_phase;        // position in the array (in frames)
+    float*      m_speed;        // frames per sample
+    float*      m_window;       // position in the window (0. to 1.)
+    float*      m_window_inc;   // 1. / length of the grain (in samps)
+    int*        m_left;         // number of samples left
+    int*        m_start;        // first sample to render in the block, not 0 only for the grains started in this block
+
+    float       m_duration;     // length of the next grains (in ms)
+    float       m_sr;
+    t_sample    m_last_trigger;
+    unsigned long m_dropped;    // triggers ignored because all the grains were active
+
+    // one block of positions and values, shared by the grains
+    int*        m_indices;
+    float*      m_fracs;
+    float*      m_values;
+
+    t_inlet*    m_position_in;
+    t_inlet*    m_speed_in;
+    t_outlet*   m_out;
+    t_float     m_f;
+
+} t_pa_granular_tilde;
+
+static void pa_granular_init_window(void)
+{
+    const double pi = 3.14159265358979323846;
+    double term = 1.;
+    int n;
+
+    // (-4pi^2)^n / (2n)!, halved, plus 0.5 for the constant term
+    for(n = 0; n < PA_GRANULAR_WINDOW_TERMS; ++n)
+    {
+        pa_granular_window_coefs[n] = (float)(0.5 * term + (n == 0 ? 0.5 : 0.));
+        term *= -4. * pi * pi / ((2. * n + 1.) * (2. * n + 2.));
+    }
+}
+
+static void pa_granular_tilde_set_buffer(t_pa_granular_tilde* x, t_symbol* s)
+{
+    pa_array_set(&x->m_array, s, x, "pa.granular~");
+}
+
+//! @brief duration <ms> : the length of the next grains.
+static void pa_granular_tilde_set_duration(t_pa_granular_tilde* x, t_floatarg f)
+{
+    x->m_duration = (f > 0.f) ? f : 0.f;
+}
+
+static void pa_granular_tilde_status(t_pa_granular_tilde* x)
+{
+    post("pa.granular~: %d/%d grains, %lu triggers dropped", x->m_active, x->m_maxgrains, x->m_dropped);
+}
+
+//! @brief Start the grains of the block, before anything is written to the output (it may be an input vector).
+static void pa_granular_start_grains(t_pa_granular_tilde* x, t_sample const* triggers,
+                                     t_sample const* positions, t_sample const* speeds, int n)
+{
+    const int size = x->m_array.m_size;
+    const int length = (int)(x->m_duration * x->m_sr * 0.001f);
+    t_sample last = x->m_last_trigger;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const t_sample trigger = triggers[i];
+
+        if(last <= 0.f && trigger > 0.f && length > 0)
+        {
+            if(x->m_active < x->m_maxgrains)
+            {
+                const int g = x->m_active++;
+                const double position = (double)positions[i] - floor((double)positions[i]);
+
+                x->m_phase[g] = position * size;
+                x->m_speed[g] = speeds[i];
+                x->m_window[g] = 0.f;
+                x->m_window_inc[g] = 1.f / length;
+                x->m_left[g] = length;
+                x->m_start[g] = i;
+            }
+            else
+            {
+                x->m_dropped++;
+            }
+        }
+
+        last = trigger;
+    }
+
+    x->m_last_trigger = last;
+}
+
+//! @brief Add a grain to a block and move it forward, returns 0 when it's over.
+//! @details It is inlined for the stride of the Pd arrays, so that their samples are read with a constant stride.
+static inline int pa_granular_render_grain(t_pa_granular_tilde* x, int g, int stride, t_sample* out, int n)
+{
+    t_float const* samples = x->m_array.m_samples;
+    const int size = x->m_array.m_size;
+    const int start = x->m_start[g];
+    const double phase = x->m_phase[g];
+    const float speed = x->m_speed[g];
+    const float window = x->m_window[g];
+    const float window_inc = x->m_window_inc[g];
+    int* indices = x->m_indices;
+    float* fracs = x->m_fracs;
+    float* values = x->m_values;
+    t_sample* output = out + start;
+    int count = n - start;
+    int k;
+
+    if(count > x->m_left[g]) count = x->m_left[g];
+
+    // The grains that don't cross the ends of the array are neither wrapped nor interpolated with the first frame
+    // (with one frame of margin for the rounding of the single precision positions).
+    const double last = phase + (double)(count - 1) * speed;
+    if(phase >= 1. && last >= 1. && phase < size - 2 && last < size - 2)
+    {
+        // positions, relative to the frame of the start of the block so that they are computed in single precision
+        const int base = (int)phase;
+        const float offset = (float)(phase - base);
+
+        for(k = 0; k < count; ++k)
+        {
+            const float position = offset + k * speed;
+            int idx = (int)position;
+            idx -= (position < idx); // floor for the negative speeds
+            indices[k] = base + idx;
+            fracs[k] = position - idx;
+        }
+
+        // linear interpolation
+        for(k = 0; k < count; ++k)
+        {
+            const int idx = indices[k];
+            const float y1 = samples[idx * stride];
+            const float y2 = samples[(idx + 1) * stride];
+            values[k] = y1 + fracs[k] * (y2 - y1);
+        }
+    }
+    else
+    {
+        for(k = 0; k < count; ++k)
+        {
+            double position = phase + (double)k * speed;
+            position -= floor(position / size) * size;
+            int idx = (int)position;
+            if(idx >= size) { idx = 0; position = 0.; } // rounding
+            indices[k] = idx;
+            fracs[k] = (float)(position - idx);
+        }
+
+        // the frame after the last one is the first one
+        for(k = 0; k < count; ++k)
+        {
+            const int idx = indices[k];
+            const float y1 = samples[idx * stride];
+            const float y2 = samples[((idx + 1 < size) ? (idx + 1) : 0) * stride];
+            values[k] = y1 + fracs[k] * (y2 - y1);
+        }
+    }
+
+    // windowing
+    for(k = 0; k < count; ++k)
+    {
+        const float t = window + k * window_inc - 0.5f;
+        const float v = t * t;
+        float w = pa_granular_window_coefs[PA_GRANULAR_WINDOW_TERMS - 1];
+        int j;
+
+        for(j = PA_GRANULAR_WINDOW_TERMS - 2; j >= 0; --j)
+        {
+            w = w * v + pa_granular_window_coefs[j];
+        }
+
+        output[k] += values[k] * w;
+    }
+
+    // move the grain forward, its phase is kept within the array
+    double next = phase + (double)count * speed;
+    if(next < 0. || next >= size) next -= floor(next / size) * size;
+
+    x->m_phase[g] = next;
+    x->m_window[g] = window + count * window_inc;
+    x->m_left[g] -= count;
+    x->m_start[g] = 0;
+
+    return x->m_left[g] > 0;
+}
+
+//! @brief Remove a grain, the last active grain takes its place.
+static void pa_granular_remove_grain(t_pa_granular_tilde* x, int g)
+{
+    const int last = --x->m_active;
+
+    x->m_phase[g] = x->m_phase[last];
+    x->m_speed[g] = x->m_speed[last];
+    x->m_window[g] = x->m_window[last];
+    x->m_window_inc[g] = x->m_window_inc[last];
+    x->m_left[g] = x->m_left[last];
+    x->m_start[g] = x->m_start[last];
+}
+
+static t_int* pa_granular_tilde_perform(t_int *w)
+{
+    t_pa_granular_tilde* x  = (t_pa_granular_tilde *)(w[1]);
+    t_sample* triggers      = (t_sample *)(w[2]);
+    t_sample* positions     = (t_sample *)(w[3]);
+    t_sample* speeds        = (t_sample *)(w[4]);
+    t_sample* out           = (t_sample *)(w[5]);
+    int n                   = (int)(w[6]);
+    int g = 0;
+
+    // the array may be set or unset by a message between two dsp builds, so it's checked once per block.
+    if(!pa_array_isvalid(&x->m_array))
+    {
+        x->m_active = 0;
+        memset(out, 0, sizeof(t_sample) * n);
+        return (w+7);
+    }
+
+    pa_granular_start_grains(x, triggers, positions, speeds, n);
+
+    memset(out, 0, sizeof(t_sample) * n);
+
+    while(g < x->m_active)
+    {
+        const int alive = (x->m_array.m_stride == PA_ARRAY_WORD_STRIDE)
+                        ? pa_granular_render_grain(x, g, PA_ARRAY_WORD_STRIDE, out, n)
+                        : pa_granular_render_grain(x, g, x->m_array.m_stride, out, n);
+
+        if(alive)
+        {
+            ++g;
+        }
+        else
+        {
+            // the grain that takes its place is rendered next
+            pa_granular_remove_grain(x, g);
+        }
+    }
+
+    if(x->m_array.m_source && x->m_active > 0)
+    {
+        pa_mmapsource_hint(x->m_array.m_source, (int)x->m_phase[0]);
+        pa_mmapsource_hint(x->m_array.m_source, (int)x->m_phase[x->m_active - 1]);
+    }
+
+    return (w+7);
+}
+
+static void pa_granular_tilde_dsp(t_pa_granular_tilde* x, t_signal** sp)
+{
+    const int vecsize = sp[0]->s_n;
+
+    pa_array_update(&x->m_array, x, "pa.granular~");
+
+    x->m_sr = sp[0]->s_sr;
+
+    free(x->m_indices);
+    free(x->m_fracs);
+    free(x->m_values);
+    x->m_indices = (int*)malloc(sizeof(int) * vecsize);
+    x->m_fracs = (float*)malloc(sizeof(float) * vecsize);
+    x->m_values = (float*)malloc(sizeof(float) * vecsize);
+
+    if(!x->m_indices || !x->m_fracs || !x->m_values)
+    {
+        pd_error(x, "pa.granular~: can't allocate the block buffers");
+        return;
+    }
+
+    dsp_add(pa_granular_tilde_perform, 6,
+            (t_int)x,
+            (t_int)sp[0]->s_vec,    // trigger
+            (t_int)sp[1]->s_vec,    // position
+            (t_int)sp[2]->s_vec,    // speed
+            (t_int)sp[3]->s_vec,    // outlet
+            (t_int)vecsize);
+}
+
+static void pa_granular_tilde_free(t_pa_granular_tilde* x)
+{
+    inlet_free(x->m_position_in);
+    inlet_free(x->m_speed_in);
+    outlet_free(x->m_out);
+
+    free(x->m_phase);
+    free(x->m_speed);
+    free(x->m_window);
+    free(x->m_window_inc);
+    free(x->m_left);
+    free(x->m_start);
+
+    free(x->m_indices);
+    free(x->m_fracs);
+    free(x->m_values);
+}
+
+static void* pa_granular_tilde_new(t_symbol* buffer_name, t_floatarg grains, t_floatarg duration)
+{
+    t_pa_granular_tilde* x = (t_pa_granular_tilde *)pd_new(pa_granular_tilde_class);
+
+    if(x)
+    {
+        const int maxgrains = (grains >= 1.f) ? (int)grains : PA_GRANULAR_DEFAULT_GRAINS;
+
+        x->m_maxgrains = maxgrains;
+        x->m_duration = (duration > 0.f) ? duration : PA_GRANULAR_DEFAULT_DURATION;
+        x->m_sr = sys_getsr();
+
+        x->m_phase = (double*)malloc(sizeof(double) * maxgrains);
+        x->m_speed = (float*)malloc(sizeof(float) * maxgrains);
+        x->m_window = (float*)malloc(sizeof(float) * maxgrains);
+        x->m_window_inc = (float*)malloc(sizeof(float) * maxgrains);
+        x->m_left = (int*)malloc(sizeof(int) * maxgrains);
+        x->m_start = (int*)malloc(sizeof(int) * maxgrains);
+
+        if(!x->m_phase || !x->m_speed || !x->m_window || !x->m_window_inc || !x->m_left || !x->m_start)
+        {
+            pd_error(x, "pa.granular~: can't allocate %d grains", maxgrains);
+            x->m_maxgrains = 0;
+        }
+
+        pa_granular_tilde_set_buffer(x, buffer_name);
+
+        x->m_position_in = signalinlet_new((t_object *)x, 0.f);
+        x->m_speed_in = signalinlet_new((t_object *)x, 1.f);
+        x->m_out = outlet_new((t_object *)x, &s_signal);
+    }
+
+    return x;
+}
+
+extern void setup_pa0x2egranular_tilde(void)
+{
+    t_class* c = class_new(gensym("pa.granular~"),
+                           (t_newmethod)pa_granular_tilde_new, (t_method)pa_granular_tilde_free,
+                           sizeof(t_pa_granular_tilde), CLASS_DEFAULT, A_DEFSYM, A_DEFFLOAT, A_DEFFLOAT, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_granular_tilde_dsp,           gensym("dsp"),        A_CANT);
+        class_addmethod(c, (t_method)pa_granular_tilde_set_buffer,    gensym("set"),        A_DEFSYM, 0);
+        class_addmethod(c, (t_method)pa_granular_tilde_set_duration,  gensym("duration"),   A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_granular_tilde_status,        gensym("status"),     0);
+        CLASS_MAINSIGNALIN(c, t_pa_granular_tilde, m_f);
+
+        pa_granular_init_window();
+    }
+
+    pa_granular_tilde_class = c;
+}
@@ -0,0 +1,493 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief A look-ahead brickwall limiter, for one or several linked channels.
+//! @details The signals are delayed by the look-ahead (with the ringbuffer of the delay objects)
+//! while their gain is computed from the peak of all the channels :
+//! - the gain needed by each sample (threshold / peak) goes through a sliding minimum over the
+//!   look-ahead + 1 samples, kept in a monotonic deque (O(1) amortized per sample),
+//! - then through a moving average over the same length : the gain reaches the minimum with a linear-like
+//!   attack that ends exactly when the peak leaves the delay, so it is never above the gain it needs,
+//! - then through a one-pole release.
+//! The latency is the look-ahead, it is fixed at creation and reported by the right outlet.
+
+#include <m_pd.h>
+
+#include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // memset
+#include <math.h>   // fabsf, exp
+
+#include <pa_ringbuffer.h>
+
+#define PA_LIMITER_DEFAULT_LOOKAHEAD 5.f
+#define PA_LIMITER_DEFAULT_RELEASE 50.f
+#define PA_LIMITER_MAX_LOOKAHEAD 1000.f
+
+static t_class* pa_limiter_tilde_class;
+
+typedef struct _pa_limiter_tilde
+{
+    t_object            m_obj;
+
+    int                 m_channels;
+    t_pa_ringbuffer*    m_buffers;      // the look-ahead delay of each channel
+
+    float               m_lookahead_ms;
+    int                 m_lookahead;    // in samples, the latency
+    float               m_threshold;
+    float               m_release_ms;
+    float               m_release_coeff;
+    float               m_sr;
+
+    // sliding minimum of the needed gains (the window is m_lookahead + 1 samples)
+    float*              m_deque_gains;
+    unsigned int*       m_deque_times;
+    int                 m_deque_front;
+    int                 m_deque_count;
+    unsigned int        m_time;
+
+    // moving average of the minimums
+    float*              m_history;
+    int                 m_history_pos;
+    double              m_sum;
+
+    float               m_gain;         // the gain of the last sample (after the release)
+    int                 m_quiet;        // number of samples since the last one above the threshold (up to 2 windows)
+
+    // one block of peaks and gains, shared by the channels
+    t_sample*           m_peaks;
+    t_sample*           m_gains;
+
+    t_outlet**          m_outlets;
+    t_outlet*           m_latency_out;
+    t_sample**          m_inputs;
+    t_sample**          m_outputs;
+    t_int*              m_dspvec;
+    t_clock*            m_clock;        // outputs the latency after a dsp build
+
+    t_float             m_f;
+
+} t_pa_limiter_tilde;
+
+//! @brief Allocate the delays and the windows for a number of samples of look-ahead, the state is reset.
+//! @return 0 on success, -1 if the allocation failed.
+static int pa_limiter_tilde_set_lookahead(t_pa_limiter_tilde* x, int lookahead)
+{
+    const int window = lookahead + 1;
+    int c, i;
+
+    free(x->m_deque_gains);
+    free(x->m_deque_times);
+    free(x->m_history);
+    x->m_deque_gains = (float*)malloc(sizeof(float) * window);
+    x->m_deque_times = (unsigned int*)malloc(sizeof(unsigned int) * window);
+    x->m_history = (float*)malloc(sizeof(float) * window);
+
+    x->m_lookahead = 0;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        pa_ringbuffer_free(x->m_buffers + c);
+
+        // the sample-by-sample path reads the sample written lookahead samples before the last one,
+        // the block of headroom of the dsp method is allocated here
+        if(pa_ringbuffer_init_headroom(x->m_buffers + c, window, sys_getblksize()))
+        {
+            break;
+        }
+    }
+
+    if(c < x->m_channels || !x->m_deque_gains || !x->m_deque_times || !x->m_history)
+    {
+        // the dsp method tries again
+        free(x->m_history);
+        x->m_history = NULL;
+        return -1;
+    }
+
+    // no reduction
+    x->m_deque_front = x->m_deque_count = 0;
+    x->m_time = 0;
+
+    for(i = 0; i < window; ++i)
+    {
+        x->m_history[i] = 1.f;
+    }
+
+    x->m_history_pos = 0;
+    x->m_sum = window;
+    x->m_gain = 1.f;
+    x->m_quiet = 2 * window;
+
+    x->m_lookahead = lookahead;
+    return 0;
+}
+
+static void pa_limiter_tilde_set_threshold(t_pa_limiter_tilde* x, t_floatarg f)
+{
+    x->m_threshold = (f > 0.f) ? f : 0.f;
+}
+
+static void pa_limiter_tilde_update_release(t_pa_limiter_tilde* x)
+{
+    const double samples = x->m_release_ms * 0.001 * x->m_sr;
+    x->m_release_coeff = (samples > 1.) ? (float)(1. - exp(-1. / samples)) : 1.f;
+}
+
+static void pa_limiter_tilde_set_release(t_pa_limiter_tilde* x, t_floatarg f)
+{
+    x->m_release_ms = (f > 0.f) ? f : 0.f;
+    pa_limiter_tilde_update_release(x);
+}
+
+//! @brief Output the latency (in samples).
+static void pa_limiter_tilde_latency(t_pa_limiter_tilde* x)
+{
+    outlet_float(x->m_latency_out, (t_float)x->m_lookahead);
+}
+
+//! @brief Compute the gains of the block from the needed gains (in place).
+//! @details This is the only sequential part, it runs once for all the channels.
+static void pa_limiter_tilde_compute_gains(t_pa_limiter_tilde* x, t_sample* gains, int n)
+{
+    const int window = x->m_lookahead + 1;
+    const double invwindow = 1. / window;
+    const float coeff = x->m_release_coeff;
+    float* deque_gains = x->m_deque_gains;
+    unsigned int* deque_times = x->m_deque_times;
+    float* history = x->m_history;
+    int front = x->m_deque_front;
+    int count = x->m_deque_count;
+    int pos = x->m_history_pos;
+    unsigned int time = x->m_time;
+    double sum = x->m_sum;
+    float gain = x->m_gain;
+    float average = gain;
+    int i;
+
+    for(i = 0; i < n; ++i, ++time)
+    {
+        const float needed = gains[i];
+        int back;
+
+        // at most one gain leaves the window at each sample
+        if(count > 0 && time - deque_times[front] >= (unsigned int)window)
+        {
+            front = (front + 1 < window) ? (front + 1) : 0;
+            count--;
+        }
+
+        // the greater gains can't be the minimum anymore
+        while(count > 0)
+        {
+            back = front + count - 1;
+            if(back >= window) back -= window;
+            if(deque_gains[back] < needed) break;
+            count--;
+        }
+
+        back = front + count;
+        if(back >= window) back -= window;
+        deque_gains[back] = needed;
+        deque_times[back] = time;
+        count++;
+
+        // moving average of the minimums
+        const float minimum = deque_gains[front];
+        sum += (double)minimum - history[pos];
+        history[pos] = minimum;
+        pos = (pos + 1 < window) ? (pos + 1) : 0;
+
+        average = (float)(sum * invwindow);
+
+        // the attack is the average, the release is smoothed
+        gain = (average < gain) ? average : (gain + coeff * (average - gain));
+        gains[i] = gain;
+    }
+
+    // the release would take forever to reach its target with the rounding errors
+    if(gain < average && average - gain < 1e-5f) gain = average;
+
+    x->m_deque_front = front;
+    x->m_deque_count = count;
+    x->m_history_pos = pos;
+    x->m_time = time;
+    x->m_sum = sum;
+    x->m_gain = gain;
+}
+
+static t_int* pa_limiter_tilde_perform(t_int *w)
+{
+    t_pa_limiter_tilde* x = (t_pa_limiter_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample* peaks = x->m_peaks;
+    t_sample* gains = x->m_gains;
+    const float threshold = x->m_threshold;
+    int blockwise = 1;
+    int above = 0;
+    int c, i;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        x->m_inputs[c] = (t_sample *)(w[c + 3]);
+        x->m_outputs[c] = (t_sample *)(w[c + 3 + x->m_channels]);
+    }
+
+    // the peak of all the channels
+    memset(peaks, 0, sizeof(t_sample) * n);
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        t_sample const* in = x->m_inputs[c];
+
+        for(i = 0; i < n; ++i)
+        {
+            const float value = fabsf(in[i]);
+            peaks[i] = (value > peaks[i]) ? value : peaks[i];
+        }
+    }
+
+    // the gains needed by the peaks
+    for(i = 0; i < n; ++i)
+    {
+        gains[i] = (peaks[i] > threshold) ? (threshold / peaks[i]) : 1.f;
+        above |= (peaks[i] > threshold);
+    }
+
+    // nothing to limit in this block nor in the delay and the windows : the signals are only delayed
+    const int window = x->m_lookahead + 1;
+    const int idle = !above && x->m_quiet >= 2 * window && x->m_gain == 1.f;
+
+    if(idle)
+    {
+        // the gains left in the windows are all 1 (an empty deque)
+        x->m_deque_count = 0;
+        x->m_sum = window;
+        x->m_time += n;
+    }
+    else
+    {
+        pa_limiter_tilde_compute_gains(x, gains, n);
+    }
+
+    x->m_quiet = above ? 0 : ((x->m_quiet < 2 * window) ? (x->m_quiet + n) : x->m_quiet);
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        blockwise = blockwise && pa_ringbuffer_can_process_block(x->m_buffers + c, x->m_lookahead, n);
+    }
+
+    // the inputs are delayed before any output is written (an output may be the input of another channel)
+    if(blockwise)
+    {
+        for(c = 0; c < x->m_channels; ++c)
+        {
+            pa_ringbuffer_write_block(x->m_buffers + c, x->m_inputs[c], n);
+        }
+
+        for(c = 0; c < x->m_channels; ++c)
+        {
+            pa_ringbuffer_read_block(x->m_buffers + c, x->m_lookahead, x->m_outputs[c], n);
+        }
+    }
+    else
+    {
+        // the buffers don't have enough headroom, process one sample at a time
+        for(i = 0; i < n; ++i)
+        {
+            for(c = 0; c < x->m_channels; ++c)
+            {
+                pa_ringbuffer_write(x->m_buffers + c, x->m_inputs[c][i]);
+            }
+
+            for(c = 0; c < x->m_channels; ++c)
+            {
+                x->m_outputs[c][i] = pa_ringbuffer_read(x->m_buffers + c, x->m_lookahead + 1);
+            }
+        }
+    }
+
+    if(idle)
+    {
+        return (w + (3 + x->m_channels * 2));
+    }
+
+    // apply the gains, the clipping only catches the rounding errors of the average
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        t_sample* out = x->m_outputs[c];
+
+        for(i = 0; i < n; ++i)
+        {
+            float value = out[i] * gains[i];
+            value = (value < threshold) ? value : threshold;
+            value = (value > -threshold) ? value : -threshold;
+            out[i] = value;
+        }
+    }
+
+    return (w + (3 + x->m_channels * 2));
+}
+
+static void pa_limiter_tilde_dsp(t_pa_limiter_tilde* x, t_signal** sp)
+{
+    const int n = sp[0]->s_n;
+    int c;
+
+    // the look-ahead is set in ms, it changes with the sampling rate
+    if(sp[0]->s_sr != x->m_sr || !x->m_history)
+    {
+        x->m_sr = sp[0]->s_sr;
+        pa_limiter_tilde_update_release(x);
+
+        if(pa_limiter_tilde_set_lookahead(x, (int)(x->m_lookahead_ms * 0.001f * x->m_sr + 0.5f)))
+        {
+            pd_error(x, "pa.limiter~: can't allocate the look-ahead buffers");
+            return;
+        }
+    }
+
+    // keep a block of headroom so that the perform method can write a whole block before reading it
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        if(pa_ringbuffer_reserve(x->m_buffers + c, x->m_buffers[c].m_size + n))
+        {
+            pd_error(x, "pa.limiter~: can't allocate the block headroom, processing samples one by one");
+        }
+    }
+
+    free(x->m_peaks);
+    free(x->m_gains);
+    x->m_peaks = (t_sample*)malloc(sizeof(t_sample) * n);
+    x->m_gains = (t_sample*)malloc(sizeof(t_sample) * n);
+
+    if(!x->m_peaks || !x->m_gains)
+    {
+        pd_error(x, "pa.limiter~: can't allocate the block buffers");
+        return;
+    }
+
+    x->m_dspvec[0] = (t_int)x;
+    x->m_dspvec[1] = (t_int)n;
+
+    for(c = 0; c < (x->m_channels * 2); ++c)
+    {
+        x->m_dspvec[2 + c] = (t_int)sp[c]->s_vec;
+    }
+
+    dsp_addv(pa_limiter_tilde_perform, (2 + (x->m_channels * 2)), x->m_dspvec);
+
+    // the latency may have changed, it is output once the dsp chain is built
+    clock_delay(x->m_clock, 0.);
+}
+
+static void* pa_limiter_tilde_new(t_symbol* s, int argc, t_atom* argv)
+{
+    t_pa_limiter_tilde* x = (t_pa_limiter_tilde *)pd_new(pa_limiter_tilde_class);
+
+    if(x)
+    {
+        int channels = 1;
+        int c;
+
+        // number of channels, look-ahead (in ms) and threshold
+        if(argc >= 1 && argv[0].a_type == A_FLOAT && argv[0].a_w.w_float > 1)
+        {
+            channels = (int)argv[0].a_w.w_float;
+        }
+
+        x->m_lookahead_ms = PA_LIMITER_DEFAULT_LOOKAHEAD;
+        if(argc >= 2 && argv[1].a_type == A_FLOAT)
+        {
+            if(argv[1].a_w.w_float > 0 && argv[1].a_w.w_float <= PA_LIMITER_MAX_LOOKAHEAD)
+            {
+                x->m_lookahead_ms = argv[1].a_w.w_float;
+            }
+            else
+            {
+                pd_error(x, "pa.limiter~: look-ahead must be between 0 and %g ms", PA_LIMITER_MAX_LOOKAHEAD);
+            }
+        }
+
+        pa_limiter_tilde_set_threshold(x, (argc >= 3 && argv[2].a_type == A_FLOAT) ? argv[2].a_w.w_float : 1.f);
+
+        x->m_channels = channels;
+        x->m_buffers = (t_pa_ringbuffer*)calloc(channels, sizeof(t_pa_ringbuffer));
+        x->m_sr = sys_getsr();
+        pa_limiter_tilde_set_release(x, PA_LIMITER_DEFAULT_RELEASE);
+
+        if(pa_limiter_tilde_set_lookahead(x, (int)(x->m_lookahead_ms * 0.001f * x->m_sr + 0.5f)))
+        {
+            pd_error(x, "pa.limiter~: can't allocate the look-ahead buffers");
+        }
+
+        x->m_outlets = (t_outlet**)malloc(sizeof(t_outlet*) * channels);
+        x->m_inputs = (t_sample**)malloc(sizeof(t_sample*) * channels);
+        x->m_outputs = (t_sample**)malloc(sizeof(t_sample*) * channels);
+
+        // object + vecsize + inputs + outputs
+        x->m_dspvec = (t_int*)malloc(sizeof(t_int) * (2 + channels * 2));
+
+        // the first inlet is the main signal inlet
+        for(c = 1; c < channels; ++c)
+        {
+            signalinlet_new((t_object*)x, 0.f);
+        }
+
+        for(c = 0; c < channels; ++c)
+        {
+            x->m_outlets[c] = outlet_new((t_object *)x, &s_signal);
+        }
+
+        x->m_latency_out = outlet_new((t_object *)x, &s_float);
+        x->m_clock = clock_new(x, (t_method)pa_limiter_tilde_latency);
+    }
+
+    return x;
+}
+
+static void pa_limiter_tilde_free(t_pa_limiter_tilde* x)
+{
+    int c;
+
+    clock_free(x->m_clock);
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        pa_ringbuffer_free(x->m_buffers + c);
+        outlet_free(x->m_outlets[c]);
+    }
+
+    outlet_free(x->m_latency_out);
+
+    free(x->m_buffers);
+    free(x->m_outlets);
+    free(x->m_inputs);
+    free(x->m_outputs);
+    free(x->m_dspvec);
+
+    free(x->m_deque_gains);
+    free(x->m_deque_times);
+    free(x->m_history);
+    free(x->m_peaks);
+    free(x->m_gains);
+}
+
+extern void setup_pa0x2elimiter_tilde(void)
+{
+    t_class* c = class_new(gensym("pa.limiter~"),
+                           (t_newmethod)pa_limiter_tilde_new, (t_method)pa_limiter_tilde_free,
+                           sizeof(t_pa_limiter_tilde), CLASS_DEFAULT, A_GIMME, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_limiter_tilde_dsp,              gensym("dsp"),          A_CANT);
+        class_addmethod(c, (t_method)pa_limiter_tilde_set_threshold,    gensym("threshold"),    A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_limiter_tilde_set_release,      gensym("release"),      A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_limiter_tilde_latency,          gensym("latency"),      0);
+        CLASS_MAINSIGNALIN(c, t_pa_limiter_tilde, m_f);
+    }
+
+    pa_limiter_tilde_class = c;
+}
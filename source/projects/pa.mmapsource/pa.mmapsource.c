@@ -0,0 +1,471 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Maps a sound file in memory for the readbuffer objects
+//! @details see pa_mmapsource.h
+
+#include <m_pd.h>
+
+#include <limits.h> // INT_MAX
+#include <stdio.h>  // snprintf
+#include <stdint.h> // uintptr_t
+#include <string.h> // memcmp, strcmp
+
+#if defined(_WIN32)
+#include <windows.h> // CreateFileMapping, MapViewOfFile...
+#else
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap, munmap, madvise
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close, sysconf
+#endif
+
+#include <pa_mmapsource.h>
+
+// interval of the prefetch clock (in ms)
+#define PA_MMAPSOURCE_PREFETCH_INTERVAL 20.
+
+static t_class* pa_mmapsource_class;
+
+static uint32_t pa_mmapsource_read_le(unsigned char const* bytes, int count)
+{
+    uint32_t value = 0;
+    int i;
+
+    for(i = count - 1; i >= 0; --i)
+    {
+        value = (value << 8) | bytes[i];
+    }
+
+    return value;
+}
+
+//! @brief Find the samples in the mapped bytes of a WAV file, they must be 32-bit floats.
+//! @return NULL on success, the error otherwise.
+static const char* pa_mmapsource_parse_wav(unsigned char const* bytes, size_t size,
+                                           size_t* offset, size_t* datasize, int* channels)
+{
+    size_t pos = 12;
+    int tag = 0, bits = 0;
+
+    *channels = 0;
+
+    if(size < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0)
+    {
+        return "not a WAV file (use the raw flag for raw float files)";
+    }
+
+    while(pos + 8 <= size)
+    {
+        const size_t chunksize = pa_mmapsource_read_le(bytes + pos + 4, 4);
+        const size_t start = pos + 8;
+
+        if(memcmp(bytes + pos, "fmt ", 4) == 0)
+        {
+            if(chunksize < 16 || start + 16 > size)
+            {
+                return "bad fmt chunk";
+            }
+
+            tag = (int)pa_mmapsource_read_le(bytes + start, 2);
+            *channels = (int)pa_mmapsource_read_le(bytes + start + 2, 2);
+            bits = (int)pa_mmapsource_read_le(bytes + start + 14, 2);
+
+            // WAVE_FORMAT_EXTENSIBLE: the format tag is the start of the sub format
+            if(tag == 0xFFFE && chunksize >= 26 && start + 26 <= size)
+            {
+                tag = (int)pa_mmapsource_read_le(bytes + start + 24, 2);
+            }
+        }
+        else if(memcmp(bytes + pos, "data", 4) == 0)
+        {
+            if(*channels < 1)
+            {
+                return "no fmt chunk before the data";
+            }
+
+            if(tag != 3 || bits != 32)
+            {
+                return "the samples must be 32-bit floats";
+            }
+
+            // the last chunk may be truncated
+            *offset = start;
+            *datasize = (chunksize < size - start) ? chunksize : (size - start);
+            return NULL;
+        }
+
+        // chunks are padded to an even size
+        pos = start + chunksize + (chunksize & 1);
+    }
+
+    return "no data chunk";
+}
+
+//! @brief Map a whole file read-only.
+//! @return The mapped bytes or NULL.
+static void* pa_mmapsource_map_file(const char* path, size_t* size)
+{
+    void* map = NULL;
+    *size = 0;
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER filesize;
+        if(GetFileSizeEx(file, &filesize) && filesize.QuadPart > 0 && (unsigned long long)filesize.QuadPart <= (size_t)-1)
+        {
+            // the view keeps the mapping alive, the handles can be closed
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mapping)
+            {
+                map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+                if(map) *size = (size_t)filesize.QuadPart;
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    const int fd = open(path, O_RDONLY);
+    if(fd >= 0)
+    {
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0 && (unsigned long long)st.st_size <= (size_t)-1)
+        {
+            // the mapping keeps the file open
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if(map == MAP_FAILED)
+            {
+                map = NULL;
+            }
+            else
+            {
+                *size = (size_t)st.st_size;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    return map;
+}
+
+static void pa_mmapsource_unmap_file(void* map, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+//! @brief Point the samples to the selected channel.
+static void pa_mmapsource_select_channel(t_pa_mmapsource* x, t_float const* first)
+{
+    x->m_samples = first ? (first + x->m_channel) : NULL;
+}
+
+//! @brief The samples changed, let the readers find them again (they set m_usedindsp again).
+static void pa_mmapsource_changed(t_pa_mmapsource* x, int always)
+{
+    if(x->m_usedindsp || always)
+    {
+        x->m_usedindsp = 0;
+        canvas_update_dsp();
+    }
+}
+
+static void pa_mmapsource_close(t_pa_mmapsource* x)
+{
+    if(x->m_map)
+    {
+        void* map = x->m_map;
+        const size_t size = x->m_mapsize;
+
+        x->m_map = NULL;
+        x->m_mapsize = 0;
+        x->m_samples = NULL;
+        x->m_frames = 0;
+        x->m_channels = 0;
+
+        // the dsp chain is rebuilt before unmapping, so that no reader reads the old samples
+        pa_mmapsource_changed(x, 0);
+        pa_mmapsource_unmap_file(map, size);
+    }
+}
+
+//! @brief open <path> [raw] : map a WAV file of 32-bit float samples (or a raw file of 32-bit floats).
+//! @details The previous file stays open if the new one can't be read.
+static void pa_mmapsource_open(t_pa_mmapsource* x, t_symbol* s, int argc, t_atom* argv)
+{
+    void* oldmap = x->m_map;
+    const size_t oldsize = x->m_mapsize;
+    char path[MAXPDSTRING];
+    const char* error = NULL;
+    const char* name;
+    size_t offset = 0, datasize = 0, mapsize = 0;
+    int channels = 1, raw = 0;
+    unsigned char const* map;
+    size_t frames;
+
+    if(argc < 1 || argv[0].a_type != A_SYMBOL)
+    {
+        pd_error(x, "pa.mmapsource: open needs a file path");
+        return;
+    }
+
+    if(sizeof(t_float) != sizeof(float))
+    {
+        pd_error(x, "pa.mmapsource: the samples can't be read in place with %d-bit floats", (int)(8 * sizeof(t_float)));
+        return;
+    }
+
+    name = argv[0].a_w.w_symbol->s_name;
+    raw = (argc >= 2 && argv[1].a_type == A_SYMBOL && strcmp(argv[1].a_w.w_symbol->s_name, "raw") == 0);
+
+    if(name[0] != '/' && !(name[0] && name[1] == ':') && x->m_dir)
+    {
+        snprintf(path, MAXPDSTRING, "%s/%s", x->m_dir->s_name, name);
+    }
+    else
+    {
+        snprintf(path, MAXPDSTRING, "%s", name);
+    }
+
+    map = (unsigned char const*)pa_mmapsource_map_file(path, &mapsize);
+    if(!map)
+    {
+        pd_error(x, "pa.mmapsource: can't map %s", path);
+        return;
+    }
+
+    if(raw)
+    {
+        datasize = mapsize;
+    }
+    else
+    {
+        error = pa_mmapsource_parse_wav(map, mapsize, &offset, &datasize, &channels);
+    }
+
+    // the mapping starts on a page, so the floats are aligned if their offset is
+    if(!error && offset % sizeof(float) != 0)
+    {
+        error = "the samples aren't aligned on 4 bytes";
+    }
+
+    frames = datasize / (sizeof(float) * (size_t)channels);
+    if(!error && frames == 0)
+    {
+        error = "empty file";
+    }
+
+    if(error)
+    {
+        pd_error(x, "pa.mmapsource: %s: %s", path, error);
+        pa_mmapsource_unmap_file((void*)map, mapsize);
+        return;
+    }
+
+    // the readers use int indices
+    if(frames > INT_MAX)
+    {
+        pd_error(x, "pa.mmapsource: %s: only the first %d frames can be read", path, INT_MAX);
+        frames = INT_MAX;
+    }
+
+    x->m_map = (void*)map;
+    x->m_mapsize = mapsize;
+    x->m_frames = (int)frames;
+    x->m_channels = channels;
+    if(x->m_channel >= channels) x->m_channel = channels - 1;
+    pa_mmapsource_select_channel(x, (t_float const*)(map + offset));
+
+    // the readers created before the source also find it
+    pa_mmapsource_changed(x, 1);
+
+    if(oldmap)
+    {
+        pa_mmapsource_unmap_file(oldmap, oldsize);
+    }
+}
+
+//! @brief channel <n> : read the channel n of the file (from 1).
+static void pa_mmapsource_channel(t_pa_mmapsource* x, t_floatarg f)
+{
+    int channel = (int)f - 1;
+
+    if(channel < 0) channel = 0;
+    if(x->m_channels > 0 && channel >= x->m_channels)
+    {
+        pd_error(x, "pa.mmapsource: the file only has %d channels", x->m_channels);
+        channel = x->m_channels - 1;
+    }
+
+    if(channel != x->m_channel)
+    {
+        t_float const* first = x->m_samples ? (x->m_samples - x->m_channel) : NULL;
+
+        x->m_channel = channel;
+        pa_mmapsource_select_channel(x, first);
+        pa_mmapsource_changed(x, 0);
+    }
+}
+
+//! @brief Ask the system to read the pages of some frames in the background.
+static void pa_mmapsource_prefetch_frames(t_pa_mmapsource* x, int first, int last)
+{
+    if(first < 0) first = 0;
+    if(last >= x->m_frames) last = x->m_frames - 1;
+
+    if(x->m_samples && first <= last)
+    {
+#if defined(_WIN32)
+        // PrefetchVirtualMemory() needs Windows 8, the pages are read when they are touched
+        (void)x;
+#else
+        const uintptr_t pagesize = (uintptr_t)sysconf(_SC_PAGESIZE);
+        const uintptr_t mapend = (uintptr_t)x->m_map + x->m_mapsize;
+        uintptr_t start = (uintptr_t)(x->m_samples + (size_t)first * x->m_channels);
+        uintptr_t end = (uintptr_t)(x->m_samples + ((size_t)last + 1) * x->m_channels);
+
+        start &= ~(pagesize - 1);
+        if(end > mapend) end = mapend;
+
+        madvise((void*)start, (size_t)(end - start), MADV_WILLNEED);
+#endif
+    }
+}
+
+//! @brief The prefetch clock: prefetch the frames around the ones read since the last tick.
+static void pa_mmapsource_tick(t_pa_mmapsource* x)
+{
+    const int window = x->m_prefetch;
+    const int first = x->m_hint_first;
+    const int last = x->m_hint_last;
+
+    if(first <= last)
+    {
+        // readers far from each other are prefetched separately
+        if(last - first <= 4 * window)
+        {
+            pa_mmapsource_prefetch_frames(x, first - window, last + window);
+        }
+        else
+        {
+            pa_mmapsource_prefetch_frames(x, first - window, first + window);
+            pa_mmapsource_prefetch_frames(x, last - window, last + window);
+        }
+    }
+
+    x->m_hint_first = INT_MAX;
+    x->m_hint_last = -1;
+
+    if(x->m_prefetch > 0)
+    {
+        clock_delay(x->m_clock, PA_MMAPSOURCE_PREFETCH_INTERVAL);
+    }
+}
+
+//! @brief prefetch <frames> : prefetch this number of frames around the readers, 0 to stop.
+static void pa_mmapsource_prefetch(t_pa_mmapsource* x, t_floatarg f)
+{
+    const int prefetch = (f > 0) ? (int)f : 0;
+
+    if(prefetch > 0 && x->m_prefetch <= 0)
+    {
+        x->m_hint_first = INT_MAX;
+        x->m_hint_last = -1;
+        clock_delay(x->m_clock, PA_MMAPSOURCE_PREFETCH_INTERVAL);
+    }
+    else if(prefetch <= 0)
+    {
+        clock_unset(x->m_clock);
+    }
+
+    x->m_prefetch = prefetch;
+}
+
+static void pa_mmapsource_status(t_pa_mmapsource* x)
+{
+    if(!x->m_map)
+    {
+        post("pa.mmapsource: %s: no file", x->m_name->s_name);
+        return;
+    }
+
+    post("pa.mmapsource: %s: %d frames, channel %d of %d, %d frames prefetched",
+         x->m_name->s_name, x->m_frames, x->m_channel + 1, x->m_channels, x->m_prefetch);
+}
+
+static void* pa_mmapsource_new(t_symbol* s, int argc, t_atom* argv)
+{
+    t_pa_mmapsource* x = (t_pa_mmapsource *)pd_new(pa_mmapsource_class);
+
+    if(x)
+    {
+        x->m_name = &s_;
+        x->m_hint_first = INT_MAX;
+        x->m_hint_last = -1;
+        x->m_clock = clock_new(x, (t_method)pa_mmapsource_tick);
+        x->m_dir = canvas_getdir(canvas_getcurrent());
+
+        if(argc >= 1 && argv->a_type == A_SYMBOL)
+        {
+            x->m_name = argv->a_w.w_symbol;
+
+            if(pa_mmapsource_find(x->m_name))
+            {
+                pd_error(x, "pa.mmapsource: %s: multiply defined", x->m_name->s_name);
+            }
+
+            pd_bind(&x->m_obj.ob_pd, x->m_name);
+        }
+        else
+        {
+            pd_error(x, "pa.mmapsource: first argument must be the name of the source");
+        }
+
+        // the other arguments are the ones of the open message
+        if(argc >= 2)
+        {
+            pa_mmapsource_open(x, gensym("open"), argc - 1, argv + 1);
+        }
+    }
+
+    return x;
+}
+
+static void pa_mmapsource_free(t_pa_mmapsource* x)
+{
+    if(x->m_name != &s_)
+    {
+        pd_unbind(&x->m_obj.ob_pd, x->m_name);
+    }
+
+    clock_free(x->m_clock);
+    pa_mmapsource_close(x);
+}
+
+extern void setup_pa0x2emmapsource(void)
+{
+    t_class* c = class_new(gensym(PA_MMAPSOURCE_CLASS_NAME),
+                           (t_newmethod)pa_mmapsource_new, (t_method)pa_mmapsource_free,
+                           sizeof(t_pa_mmapsource), CLASS_DEFAULT, A_GIMME, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_mmapsource_open,        gensym("open"),     A_GIMME, 0);
+        class_addmethod(c, (t_method)pa_mmapsource_close,       gensym("close"),    0);
+        class_addmethod(c, (t_method)pa_mmapsource_channel,     gensym("channel"),  A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_mmapsource_prefetch,    gensym("prefetch"), A_FLOAT, 0);
+        class_addmethod(c, (t_method)pa_mmapsource_status,      gensym("status"),   0);
+    }
+
+    pa_mmapsource_class = c;
+}
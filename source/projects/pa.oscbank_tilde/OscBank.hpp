@@ -0,0 +1,167 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "Osc.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                     OSC BANK                                     //
+    // ================================================================================ //
+
+    //! @brief A bank of cosine oscillators stored as a structure of arrays.
+    //! @details Phases, increments and amplitudes of all the oscillators are stored
+    //! in contiguous arrays and processed a block at a time, one oscillator after the other,
+    //! so that the inner loops over the block can be vectorized.
+    //! Call simd::init() once to select the fastest table lookup kernel for the running cpu.
+    //! TableSize sets the number of points of the cosine table.
+    template<class SampleType, size_t TableSize = PACCPP_COSTABLE_SIZE>
+    class OscBank
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+        using costable_t = CosTable<sample_t, TableSize>;
+
+        //! Default constructor
+        OscBank() = default;
+
+        //! Destructor
+        ~OscBank() = default;
+
+        //! @brief Returns the number of oscillators
+        size_t size() const
+        {
+            return m_freqs.size();
+        }
+
+        //! @brief Set the current sampling rate
+        //! @details You need to set a valid samplerate before calling any process method
+        void setSampleRate(sample_t samplerate)
+        {
+            m_sr = samplerate;
+
+            for(size_t i = 0; i < size(); ++i)
+            {
+                computeIncrement(i);
+            }
+        }
+
+        //! @brief Resize the bank
+        //! @details Existing oscillators keep their phase, new ones start at 0. with an amplitude of 1.
+        void resize(size_t count)
+        {
+            m_freqs.resize(count, 0.);
+            m_phases.resize(count, 0.);
+            m_increments.resize(count, 0.);
+            m_amplitudes.resize(count, 1.);
+        }
+
+        //! @brief Set the frequency of an oscillator
+        void setFrequency(size_t idx, sample_t freq)
+        {
+            m_freqs[idx] = freq;
+            computeIncrement(idx);
+        }
+
+        //! @brief Get the frequency of an oscillator
+        sample_t getFrequency(size_t idx) const
+        {
+            return m_freqs[idx];
+        }
+
+        //! @brief Set the amplitude of an oscillator
+        void setAmplitude(size_t idx, sample_t amp)
+        {
+            m_amplitudes[idx] = amp;
+        }
+
+        //! @brief Process a block of samples
+        //! @details Sum the output of all the oscillators, scaled by their amplitude
+        //! and normalized by the number of oscillators, then increment their phases.
+        void process(sample_t* outs, long vecsize)
+        {
+            std::fill(outs, outs + vecsize, sample_t(0.));
+
+            const size_t count = size();
+
+            if(count == 0)
+            {
+                return;
+            }
+
+            const sample_t norm = sample_t(1.) / count;
+
+            sample_t const* increments = m_increments.data();
+            sample_t const* amplitudes = m_amplitudes.data();
+            sample_t* phases = m_phases.data();
+
+            for(size_t i = 0; i < count; ++i)
+            {
+                const sample_t inc = increments[i];
+                const sample_t amp = amplitudes[i] * norm;
+                sample_t phase = phases[i];
+
+                // the block is processed by chunks to keep the phases on the stack.
+                for(long start = 0; start < vecsize; start += chunk_size)
+                {
+                    const long n = (vecsize - start < chunk_size) ? (vecsize - start) : chunk_size;
+                    sample_t chunk[chunk_size];
+
+                    // the phase of each sample is computed from the start of the chunk
+                    // so that there is no dependency between two iterations.
+                    for(long j = 0; j < n; ++j)
+                    {
+                        const sample_t p = phase + inc * j;
+
+                        // wrap phase between 0. and 1.
+                        chunk[j] = p - std::floor(p);
+                    }
+
+                    m_costable.getInterp(chunk, chunk, n);
+
+                    sample_t* out = outs + start;
+                    for(long j = 0; j < n; ++j)
+                    {
+                        out[j] += amp * chunk[j];
+                    }
+
+                    phase += inc * n;
+                    phase -= std::floor(phase);
+                }
+
+                phases[i] = phase;
+            }
+        }
+
+    private: // methods
+
+        void computeIncrement(size_t idx)
+        {
+            m_increments[idx] = (m_sr > 0.) ? (m_freqs[idx] / m_sr) : 0.;
+        }
+
+    private: // variables
+
+        static const long chunk_size = 64;
+
+        // the table is computed at compile time
+        static constexpr costable_t m_costable = {};
+
+        sample_t                m_sr = 0.;
+        std::vector<sample_t>   m_freqs;
+        std::vector<sample_t>   m_phases;
+        std::vector<sample_t>   m_increments;
+        std::vector<sample_t>   m_amplitudes;
+    };
+
+    template<class SampleType, size_t TableSize>
+    constexpr typename OscBank<SampleType, TableSize>::costable_t OscBank<SampleType, TableSize>::m_costable;
+}
@@ -0,0 +1,227 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PACCPP_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need to be told that a function may use a given instruction set,
+// MSVC lets us use any intrinsic everywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define PACCPP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PACCPP_TARGET(isa)
+#endif
+
+namespace paccpp
+{
+    namespace simd
+    {
+        // ================================================================================ //
+        //                              TABLE LOOKUP KERNELS                                //
+        // ================================================================================ //
+
+        //! @brief Signature of the linear interpolated table lookup kernels.
+        //! @details Each phase is multiplied by scale to get a floating-point table index,
+        //! the table must hold one more sample than the greatest index reached.
+        //! outs may be the same array as phases.
+        using interp_fn = void (*)(float const* table, float scale,
+                                   float const* phases, float* outs, size_t n);
+
+        //! @brief Scalar version, used for the remaining samples and when no SIMD is available.
+        inline void interpScalar(float const* table, float scale,
+                                 float const* phases, float* outs, size_t n)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                const float phase = phases[i] * scale;
+                const int idx = static_cast<int>(phase);
+                const float delta = phase - idx;
+                const float y1 = table[idx];
+                outs[i] = y1 + delta * (table[idx+1] - y1);
+            }
+        }
+
+#if defined(PACCPP_SIMD_X86)
+
+        //! @brief SSE2 version, index and interpolation are vectorized but SSE2 has no gather.
+        PACCPP_TARGET("sse2")
+        inline void interpSSE2(float const* table, float scale,
+                               float const* phases, float* outs, size_t n)
+        {
+            const __m128 vscale = _mm_set1_ps(scale);
+            size_t i = 0;
+
+            for(; i + 4 <= n; i += 4)
+            {
+                const __m128 phase = _mm_mul_ps(_mm_loadu_ps(phases + i), vscale);
+                const __m128i idx = _mm_cvttps_epi32(phase);
+                const __m128 delta = _mm_sub_ps(phase, _mm_cvtepi32_ps(idx));
+
+                alignas(16) int id[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(id), idx);
+
+                const __m128 y1 = _mm_setr_ps(table[id[0]], table[id[1]], table[id[2]], table[id[3]]);
+                const __m128 y2 = _mm_setr_ps(table[id[0]+1], table[id[1]+1], table[id[2]+1], table[id[3]+1]);
+
+                _mm_storeu_ps(outs + i, _mm_add_ps(y1, _mm_mul_ps(delta, _mm_sub_ps(y2, y1))));
+            }
+
+            interpScalar(table, scale, phases + i, outs + i, n - i);
+        }
+
+        //! @brief AVX2 version, gathers 8 table values at once.
+        PACCPP_TARGET("avx2")
+        inline void interpAVX2(float const* table, float scale,
+                               float const* phases, float* outs, size_t n)
+        {
+            const __m256 vscale = _mm256_set1_ps(scale);
+            const __m256i one = _mm256_set1_epi32(1);
+            size_t i = 0;
+
+            for(; i + 8 <= n; i += 8)
+            {
+                const __m256 phase = _mm256_mul_ps(_mm256_loadu_ps(phases + i), vscale);
+                const __m256i idx = _mm256_cvttps_epi32(phase);
+                const __m256 delta = _mm256_sub_ps(phase, _mm256_cvtepi32_ps(idx));
+
+                const __m256 y1 = _mm256_i32gather_ps(table, idx, 4);
+                const __m256 y2 = _mm256_i32gather_ps(table, _mm256_add_epi32(idx, one), 4);
+
+                _mm256_storeu_ps(outs + i, _mm256_add_ps(y1, _mm256_mul_ps(delta, _mm256_sub_ps(y2, y1))));
+            }
+
+            interpScalar(table, scale, phases + i, outs + i, n - i);
+        }
+
+        // GCC's own avx512 intrinsics trigger false uninitialized warnings.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+        //! @brief AVX-512 version, gathers 16 table values at once.
+        PACCPP_TARGET("avx512f")
+        inline void interpAVX512(float const* table, float scale,
+                                 float const* phases, float* outs, size_t n)
+        {
+            const __m512 vscale = _mm512_set1_ps(scale);
+            const __m512i one = _mm512_set1_epi32(1);
+            size_t i = 0;
+
+            for(; i + 16 <= n; i += 16)
+            {
+                const __m512 phase = _mm512_mul_ps(_mm512_loadu_ps(phases + i), vscale);
+                const __m512i idx = _mm512_cvttps_epi32(phase);
+                const __m512 delta = _mm512_sub_ps(phase, _mm512_cvtepi32_ps(idx));
+
+                const __m512 y1 = _mm512_i32gather_ps(idx, table, 4);
+                const __m512 y2 = _mm512_i32gather_ps(_mm512_add_epi32(idx, one), table, 4);
+
+                _mm512_storeu_ps(outs + i, _mm512_add_ps(y1, _mm512_mul_ps(delta, _mm512_sub_ps(y2, y1))));
+            }
+
+            interpScalar(table, scale, phases + i, outs + i, n - i);
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // PACCPP_SIMD_X86
+
+        // ================================================================================ //
+        //                                     DISPATCH                                     //
+        // ================================================================================ //
+
+        //! @brief The instruction sets we know about, from the least to the most capable.
+        enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+        //! @brief Returns the most capable instruction set supported by the running cpu and os.
+        inline Isa detect()
+        {
+#if defined(PACCPP_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+            if(__builtin_cpu_supports("avx2")) return Isa::AVX2;
+            if(__builtin_cpu_supports("sse2")) return Isa::SSE2;
+#elif defined(PACCPP_SIMD_X86) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            const int max_leaf = info[0];
+            __cpuid(info, 1);
+            const bool sse2 = (info[3] & (1 << 26)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+            if(max_leaf >= 7 && (xcr0 & 0x6) == 0x6)
+            {
+                __cpuidex(info, 7, 0);
+                if((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16))) return Isa::AVX512;
+                if(info[1] & (1 << 5)) return Isa::AVX2;
+            }
+            if(sse2) return Isa::SSE2;
+#endif
+            return Isa::Scalar;
+        }
+
+        //! @brief Holds the selected kernels.
+        //! @details This is a template only to let the static members be defined in this header.
+        template<class Dummy = void>
+        struct Dispatcher
+        {
+            static Isa          isa;
+            static interp_fn    interp;
+        };
+
+        template<class Dummy> Isa Dispatcher<Dummy>::isa = Isa::Scalar;
+        template<class Dummy> interp_fn Dispatcher<Dummy>::interp = &interpScalar;
+
+        //! @brief Select the kernels for the running cpu.
+        //! @details Call this once in the setup method of the object, the scalar kernels are used until then.
+        inline void init()
+        {
+            const Isa isa = detect();
+            interp_fn interp = &interpScalar;
+
+#if defined(PACCPP_SIMD_X86)
+            switch(isa)
+            {
+                case Isa::AVX512:   interp = &interpAVX512; break;
+                case Isa::AVX2:     interp = &interpAVX2; break;
+                case Isa::SSE2:     interp = &interpSSE2; break;
+                default: break;
+            }
+#endif
+
+            Dispatcher<>::isa = isa;
+            Dispatcher<>::interp = interp;
+        }
+
+        //! @brief Returns the name of the selected instruction set.
+        inline const char* getIsaName()
+        {
+            switch(Dispatcher<>::isa)
+            {
+                case Isa::AVX512:   return "avx512";
+                case Isa::AVX2:     return "avx2";
+                case Isa::SSE2:     return "sse2";
+                default:            return "scalar";
+            }
+        }
+
+        //! @brief Linear interpolated table lookup of a block of phases using the selected kernel.
+        inline void interp(float const* table, float scale, float const* phases, float* outs, size_t n)
+        {
+            Dispatcher<>::interp(table, scale, phases, outs, n);
+        }
+    }
+}
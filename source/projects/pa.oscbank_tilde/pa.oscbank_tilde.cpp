@@ -7,10 +7,9 @@
 //! @brief A bank of cosine wave oscillators
 
 #include <m_pd.h>
-#include <vector>
 
-#include "Osc.hpp"
-using paccpp::Osc;
+#include "OscBank.hpp"
+using paccpp::OscBank;
 
 static t_class *pa_oscbank_tilde_class;
 
@@ -18,8 +17,8 @@ typedef struct _pa_oscbank_tilde
 {
     t_object    m_obj;
 
-    // store a vector of Osc pointers
-    std::vector<Osc<float>*> m_oscbank;
+    // store an OscBank pointer
+    OscBank<float>* m_oscbank;
 
     t_outlet*   m_out;
 
@@ -27,40 +26,40 @@ typedef struct _pa_oscbank_tilde
 
 static void pa_oscbank_tilde_list(t_pa_oscbank_tilde* x, t_symbol* s, int argc, t_atom* argv)
 {
-    float sr = sys_getsr();
-    
-    // reserve space for new oscillators in the vector
-    x->m_oscbank.reserve(argc);
+    // new oscillators are added or useless ones removed,
+    // the others keep their current phase.
+    x->m_oscbank->resize(argc);
+    x->m_oscbank->setSampleRate(sys_getsr());
     
     for(int i = 0; i < argc; ++i)
     {
-        // allocate a new Osc object if needed
-        if(x->m_oscbank.size() <= i)
-        {
-            x->m_oscbank.push_back(new Osc<float>());
-            x->m_oscbank[i]->setSampleRate(sr);
-        }
-        
         if(argv[i].a_type == A_FLOAT)
         {
-            x->m_oscbank[i]->setFrequency(argv[i].a_w.w_float);
+            x->m_oscbank->setFrequency(i, argv[i].a_w.w_float);
         }
         else
         {
-            x->m_oscbank[i]->setFrequency(0.f);
+            x->m_oscbank->setFrequency(i, 0.f);
             error("bad frequency for osc %i, reset to 0Hz", i);
         }
     }
+}
+
+static void pa_oscbank_tilde_amps(t_pa_oscbank_tilde* x, t_symbol* s, int argc, t_atom* argv)
+{
+    const int osc_count = (int)x->m_oscbank->size();
     
-    // delete all useless pointers and remove them from the vector
-    if(x->m_oscbank.size() > argc)
+    for(int i = 0; i < argc && i < osc_count; ++i)
     {
-        for(int i = argc; i < x->m_oscbank.size(); ++i)
+        if(argv[i].a_type == A_FLOAT)
         {
-            delete x->m_oscbank[i];
+            x->m_oscbank->setAmplitude(i, argv[i].a_w.w_float);
+        }
+        else
+        {
+            x->m_oscbank->setAmplitude(i, 0.f);
+            error("bad amplitude for osc %i, reset to 0", i);
         }
-        
-        x->m_oscbank.erase(x->m_oscbank.begin()+argc, x->m_oscbank.end());
     }
 }
 
@@ -71,19 +70,7 @@ static t_int* pa_oscbank_tilde_perform(t_int* w)
 
     int vecsize = (int)(w[3]);
     
-    const size_t osc_count = (!x->m_oscbank.empty()) ? x->m_oscbank.size() : 1ul;
-    
-    while(vecsize--)
-    {
-        double out = 0.f;
-        
-        for(Osc<float>* osc : x->m_oscbank)
-        {
-            out += osc->process();
-        }
-        
-        *outs++ = out / osc_count;
-    }
+    x->m_oscbank->process(outs, vecsize);
 
     return (w+4);
 }
@@ -91,12 +78,7 @@ static t_int* pa_oscbank_tilde_perform(t_int* w)
 static void pa_oscbank_tilde_dsp(t_pa_oscbank_tilde* x, t_signal **sp)
 {
     // set samplerate of all oscillators
-    const float sr = sys_getsr();
-    
-    for(Osc<float>* osc : x->m_oscbank)
-    {
-        osc->setSampleRate(sr);
-    }
+    x->m_oscbank->setSampleRate(sys_getsr());
 
     dsp_add(pa_oscbank_tilde_perform, 3,
             x,
@@ -109,6 +91,10 @@ static void *pa_oscbank_tilde_new(t_symbol *s, int argc, t_atom *argv)
     t_pa_oscbank_tilde* x = (t_pa_oscbank_tilde*)pd_new(pa_oscbank_tilde_class);
     if(x)
     {
+        // instantiate a new OscBank object
+        // Note: dont forget to delete it in the free method !
+        x->m_oscbank = new OscBank<float>();
+        
         x->m_out = outlet_new((t_object *)x, &s_signal);
     }
 
@@ -119,14 +105,8 @@ static void pa_oscbank_tilde_free(t_pa_oscbank_tilde* x)
 {
     outlet_free(x->m_out);
 
-    // free the memory allocated for each Osc objects of the vector
-    for(Osc<float>* osc : x->m_oscbank)
-    {
-        delete osc;
-    }
-    
-    // then clear the vector
-    x->m_oscbank.clear();
+    // free the memory for the OscBank object
+    delete x->m_oscbank;
 }
 
 // Note in c++ you need to wrap the setup method in an extern "C" statement.
@@ -134,6 +114,9 @@ extern "C"
 {
     extern void setup_pa0x2eoscbank_tilde(void)
     {
+        // select the table lookup kernels for the running cpu
+        paccpp::simd::init();
+        
         t_class* c = class_new(gensym("pa.oscbank~"),
                                (t_newmethod)pa_oscbank_tilde_new, (t_method)pa_oscbank_tilde_free,
                                sizeof(t_pa_oscbank_tilde), CLASS_DEFAULT, A_GIMME, 0);
@@ -141,6 +124,7 @@ extern "C"
         {
             class_addmethod(c, (t_method)pa_oscbank_tilde_dsp,  gensym("dsp"),  A_CANT);
             class_addmethod(c, (t_method)pa_oscbank_tilde_list, gensym("list"), A_GIMME, 0);
+            class_addmethod(c, (t_method)pa_oscbank_tilde_amps, gensym("amps"), A_GIMME, 0);
         }
 
         pa_oscbank_tilde_class = c;
@@ -5,54 +5,123 @@
  */
 
 #include "Phasor.hpp"
+#include "Simd.hpp"
 
-#include <array>
+#include <cstddef>
 
-#define _USE_MATH_DEFINES
-#include <math.h>
+// Default size of the cosine tables, can be set per deployment by the build system.
+#ifndef PACCPP_COSTABLE_SIZE
+#define PACCPP_COSTABLE_SIZE 512
+#endif
 
 namespace paccpp
 {
+    namespace detail
+    {
+        constexpr double pi = 3.14159265358979323846;
+        
+        //! @brief Returns cos(x) for x between 0. and pi/2. at compile time.
+        //! @details Taylor series up to x^22 evaluated with the Horner scheme,
+        //! the error is below the double precision on this range.
+        constexpr double cosPoly(double x)
+        {
+            const double x2 = x * x;
+            double r = 1.;
+            
+            for(int k = 11; k >= 1; --k)
+            {
+                r = 1. - x2 / ((2. * k - 1.) * (2. * k)) * r;
+            }
+            
+            return r;
+        }
+        
+        //! @brief Returns cos(2 * pi * idx / size) at compile time.
+        //! @details The index is reduced to the first quadrant so that the polynomial stays accurate,
+        //! size must be a multiple of 4.
+        constexpr double cosIndex(size_t idx, size_t size)
+        {
+            const size_t quarter = size / 4;
+            const size_t quadrant = (idx / quarter) % 4;
+            const double x = 2. * pi * (idx % quarter) / size;
+            
+            return (quadrant == 0) ? cosPoly(x)
+                 : (quadrant == 1) ? -cosPoly(pi * 0.5 - x)
+                 : (quadrant == 2) ? -cosPoly(x)
+                 : cosPoly(pi * 0.5 - x);
+        }
+        
+        //! @brief Block table lookup, float blocks use the kernel selected by simd::init().
+        inline void interpBlock(float const* table, float scale,
+                                float const* phases, float* outs, size_t n)
+        {
+            simd::interp(table, scale, phases, outs, n);
+        }
+        
+        //! @brief Block table lookup for the other sample types.
+        template<class SampleType>
+        void interpBlock(SampleType const* table, SampleType scale,
+                         SampleType const* phases, SampleType* outs, size_t n)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                const SampleType phase = phases[i] * scale;
+                const size_t idx = static_cast<size_t>(phase);
+                const SampleType delta = phase - idx;
+                const SampleType y1 = table[idx];
+                outs[i] = y1 + delta * (table[idx+1] - y1);
+            }
+        }
+    }
+    
     // ================================================================================ //
     //                                    COS TABLE                                     //
     // ================================================================================ //
     
     //! @brief A cosine wave table that can be read with a phase between 0. and 1.
-    template<class SampleType, size_t TableSize = 512>
+    //! @details The table is computed at compile time when it is declared constexpr,
+    //! TableSize sets the number of points and SampleType the precision of the table.
+    template<class SampleType, size_t TableSize = PACCPP_COSTABLE_SIZE>
     class CosTable
     {
+        static_assert(TableSize >= 4 && TableSize % 4 == 0, "table size must be a multiple of 4");
+        
     public: // methods
         
         using sample_t = SampleType;
         
         //! @brief Constructor.
         //! @details Initialize the cosinus table.
-        CosTable()
+        constexpr CosTable() : m_table{}
         {
-            const size_t tsize = size();
-            
-            for(size_t i = 0; i < tsize; ++i)
+            for(size_t i = 0; i < TableSize; ++i)
             {
-                m_table[i] = cos(2.f * M_PI * i / tsize);
+                m_table[i] = static_cast<sample_t>(detail::cosIndex(i, TableSize));
             }
             
-            m_table[m_table.size()] = m_table[0];
+            // two guard samples: the interpolation never needs to wrap,
+            // even for a phase of exactly 1.
+            m_table[TableSize] = m_table[0];
+            m_table[TableSize+1] = m_table[1];
         }
         
-        //! @brief Destructor
-        ~CosTable() = default;
-        
         //! @brief Returns the size of the array
-        size_t size() const
+        constexpr size_t size() const
+        {
+            return TableSize;
+        }
+        
+        //! @brief Returns the table samples (size() + 2 values).
+        constexpr sample_t const* data() const
         {
-            return m_table.size() - 1;
+            return m_table;
         }
         
         //! @brief Returns a linear interpolated value given a phase value between 0. and 1.
         sample_t getInterp(sample_t phase) const
         {
-            // we cast to int to keep only the integer part of the floating-point number (eg. 3.99 => 3)
-            phase *= (size() - 1);
+            // scale phase to the 0. to size() range
+            phase *= size();
             
             // we cast to int to keep only the integer part of the floating-point number (eg. 3.99 => 3)
             const size_t idx_1 = static_cast<size_t>(phase);
@@ -63,26 +132,36 @@ namespace paccpp
             const sample_t y1 = m_table[idx_1];
             
             // linear interpolation
-            // (idx2 can always be idx_1+1 thanks to the additional sample in the table)
+            // (idx2 can always be idx_1+1 thanks to the additional samples in the table)
             return y1 + delta * (m_table[idx_1+1] - y1);
         }
         
+        //! @brief Fills outs with the linear interpolated values of a block of phases between 0. and 1.
+        //! @details outs may be the same array as phases.
+        //! Call simd::init() once to select the fastest kernel for the running cpu.
+        void getInterp(sample_t const* phases, sample_t* outs, size_t n) const
+        {
+            detail::interpBlock(m_table, static_cast<sample_t>(size()), phases, outs, n);
+        }
+        
     private: // variables
         
-        std::array<sample_t, TableSize+1> m_table;
+        sample_t m_table[TableSize+2];
     };
     
     // ================================================================================ //
     //                                       OSC                                        //
     // ================================================================================ //
     
-    template<class SampleType>
+    //! @brief A cosine wave oscillator
+    //! @details TableSize sets the number of points of the cosine table.
+    template<class SampleType, size_t TableSize = PACCPP_COSTABLE_SIZE>
     class Osc
     {
     public: // methods
         
         using sample_t = SampleType;
-        using costable_t = CosTable<sample_t, 512>;
+        using costable_t = CosTable<sample_t, TableSize>;
         
         //! Default constructor
         Osc() = default;
@@ -124,22 +203,21 @@ namespace paccpp
         //! then increment the oscillator phase and return current value
         void process(sample_t const* freqs, sample_t* outs, long vecsize)
         {
-            while(vecsize--)
-            {
-                m_phasor.setFrequency(*freqs++);
-                *outs++ = process();
-            }
+            // compute the phases of the block first, then read the table in place.
+            m_phasor.process(freqs, outs, vecsize);
+            m_costable.getInterp(outs, outs, vecsize);
         }
         
     private: // variables
         
-        static const costable_t m_costable;
+        // the table is computed at compile time
+        static constexpr costable_t m_costable = {};
         
         Phasor<sample_t> m_phasor = {};
     };
     
-    // Les variables statiques doivent être initialisées à l'extérieur de la classe:
-    template<class SampleType>
-    typename Osc<SampleType>::costable_t const Osc<SampleType>::m_costable = {};
+    // Les variables statiques doivent être définies à l'extérieur de la classe:
+    template<class SampleType, size_t TableSize>
+    constexpr typename Osc<SampleType, TableSize>::costable_t Osc<SampleType, TableSize>::m_costable;
     
 }
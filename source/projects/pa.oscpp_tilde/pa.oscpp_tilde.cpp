@@ -79,6 +79,9 @@ extern "C"
 {
     extern void setup_pa0x2eoscpp_tilde(void)
     {
+        // select the table lookup kernels for the running cpu
+        paccpp::simd::init();
+        
         t_class* c = class_new(gensym("pa.oscpp~"),
                                (t_newmethod)pa_oscpp_tilde_new, (t_method)pa_oscpp_tilde_free,
                                sizeof(t_pa_oscpp_tilde), CLASS_DEFAULT, A_GIMME, 0);
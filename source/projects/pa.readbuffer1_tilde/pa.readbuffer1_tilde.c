@@ -4,17 +4,19 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 
-//! @brief Access samples of a Pd array
+//! @brief Access samples of a Pd array (or of a file mapped by pa.mmapsource)
 
 #include <m_pd.h>
 
+#include <string.h> // memset
+
+#include <pa_array.h>
+
 typedef struct _pa_readbuffer1
 {
     t_object    m_obj;
     
-    t_symbol*   m_name;
-    t_word*     m_buffer;
-    int         m_size;
+    t_pa_array  m_array;
     
     t_outlet*   m_out;
     t_float     m_f;
@@ -23,39 +25,30 @@ typedef struct _pa_readbuffer1
 
 static t_class* pa_readbuffer1_tilde_class;
 
-static int pa_readbuffer1_tilde_set_buffer(t_pa_readbuffer1* x, t_symbol* s)
+static void pa_readbuffer1_tilde_set_buffer(t_pa_readbuffer1* x, t_symbol* s)
 {
-    x->m_size = 0;
-    x->m_buffer = NULL;
-    
-    x->m_name = s;
-    t_garray* a = NULL;
-    
-    if(!x->m_name || x->m_name == gensym(""))
-    {
-        return -1; // no buffer set
-    }
-    
-    a = (t_garray*)pd_findbyclass(x->m_name, garray_class);
+    pa_array_set(&x->m_array, s, x, "pa.readbuffer1~");
+}
+
+//! @brief Returns the index of the sample at a position (between 0. and 1., wrapped otherwise).
+static inline int pa_readbuffer1_index(t_sample position, int size)
+{
+    int index = (int)(position * size);
     
-    if(!a)
-    {
-        pd_error(x, "pa.readbuffer1~: %s no such array.", x->m_name->s_name);
-        return -1;
-    }
+    while(index < 0) { index += size; }
+    while(index >= size) { index -= size; }
     
-    const int err = garray_getfloatwords(a, &x->m_size, &x->m_buffer);
-    if(!err)
+    return index;
+}
+
+//! @brief Read the array, there is no validity check in the loop.
+//! @details It is inlined for the stride of the Pd arrays, so that their samples are read with a constant stride.
+static inline void pa_readbuffer1_perform_valid(t_float const* samples, int stride, int size, t_sample const* in, t_sample* out, int n)
+{
+    while(n--)
     {
-        pd_error(x, "pa.readbuffer1~: %s array is empty.", x->m_name->s_name);
-        return -1;
+        *out++ = samples[pa_readbuffer1_index(*in++, size) * stride];
     }
-    
-    // mark the array as used by the DSP
-    // doing so will cause the prepare method to be called when the array is removed
-    garray_usedindsp(a);
-    
-    return 0;
 }
 
 static t_int* pa_readbuffer1_perform(t_int *w)
@@ -63,26 +56,30 @@ static t_int* pa_readbuffer1_perform(t_int *w)
     t_pa_readbuffer1* x = (t_pa_readbuffer1 *)(w[1]);
     t_sample* in   = (t_sample *)(w[2]);
     t_sample* out  = (t_sample *)(w[3]);
-    size_t n       = (size_t)(w[4]);
+    int n          = (int)(w[4]);
     
-    const int size = x->m_size;
-    t_word const* buffer = x->m_buffer;
-    int index;
+    t_pa_array const* array = &x->m_array;
     
-    while(n--)
+    // the array may be set or unset by a message between two dsp builds, so it's checked once per block.
+    if(!pa_array_isvalid(array))
+    {
+        memset(out, 0, sizeof(t_sample) * n);
+    }
+    else
     {
-        if(size > 0 && x->m_buffer)
+        // before the loop, out may be the same vector as in
+        if(array->m_source)
+        {
+            pa_mmapsource_hint(array->m_source, pa_readbuffer1_index(in[n-1], array->m_size));
+        }
+        
+        if(array->m_stride == PA_ARRAY_WORD_STRIDE)
         {
-            index = (int)(*in++ * size);
-            
-            while(index < 0) { index += size; }
-            while(index >= size) { index -= size; }
-            
-            *out++ = buffer[index].w_float;
+            pa_readbuffer1_perform_valid(array->m_samples, PA_ARRAY_WORD_STRIDE, array->m_size, in, out, n);
         }
         else
         {
-            *out++ = 0.f;
+            pa_readbuffer1_perform_valid(array->m_samples, array->m_stride, array->m_size, in, out, n);
         }
     }
     
@@ -92,7 +89,7 @@ static t_int* pa_readbuffer1_perform(t_int *w)
 
 static void pa_readbuffer1_tilde_dsp(t_pa_readbuffer1* x, t_signal** sp)
 {
-    pa_readbuffer1_tilde_set_buffer(x, x->m_name);
+    pa_array_update(&x->m_array, x, "pa.readbuffer1~");
     
     dsp_add(pa_readbuffer1_perform, 4,
             (t_int)x,
@@ -4,10 +4,40 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 
-//! @brief Read samples in a Pd array at a given speed
+//! @brief Read samples in a Pd array (or in a file mapped by pa.mmapsource) at a given speed
 
 #include <m_pd.h>
 
+#include <stdlib.h> // abs
+#include <string.h> // memset, strcmp
+#include <math.h>   // sin, cos, floorf, fabsf
+
+#include <pa_array.h>
+
+// windowed-sinc interpolation: zero crossings on each side, taps and phases of the polyphase table
+#define PA_SINC_HALF        8
+#define PA_SINC_TAPS        (2 * PA_SINC_HALF)
+#define PA_SINC_PHASES      512
+
+// above this speed the kernel isn't stretched anymore and the playback aliases again
+#define PA_SINC_MAX_FACTOR  8
+
+// cutoff of the kernel relative to the Nyquist frequency, leaves room for the transition band
+#define PA_SINC_CUTOFF      0.9
+
+enum
+{
+    PA_READBUFFER2_INTERP_LINEAR = 0,
+    PA_READBUFFER2_INTERP_SINC
+};
+
+//! @brief The kernel sampled PA_SINC_PHASES times per sample, from 0 to PA_SINC_HALF (it is symmetric).
+static float pa_readbuffer2_sinc_table[PA_SINC_HALF * PA_SINC_PHASES + 2];
+
+//! @brief The polyphase table: the PA_SINC_TAPS weights of each fractional position (one more row for 1.),
+//! the rows are normalized so that a constant signal keeps its level.
+static float pa_readbuffer2_sinc_rows[PA_SINC_PHASES + 1][PA_SINC_TAPS];
+
 typedef struct _pa_readbuffer2
 {
     t_object    m_obj;
@@ -16,9 +46,8 @@ typedef struct _pa_readbuffer2
     float       m_phase;
     
     // buffer
-    t_symbol*   m_name;
-    t_word*     m_buffer;
-    int         m_size;
+    t_pa_array  m_array;
+    int         m_interp;
     
     t_outlet*   m_out;
     t_float     m_f;
@@ -27,49 +56,223 @@ typedef struct _pa_readbuffer2
 
 static t_class* pa_readbuffer2_tilde_class;
 
-static int pa_readbuffer2_tilde_set_buffer(t_pa_readbuffer2* x, t_symbol* s)
+static void pa_readbuffer2_tilde_set_buffer(t_pa_readbuffer2* x, t_symbol* s)
 {
-    x->m_size = 0;
-    x->m_buffer = NULL;
-    
-    x->m_name = s;
-    t_garray* a = NULL;
-    
-    if(!x->m_name || x->m_name == gensym(""))
+    pa_array_set(&x->m_array, s, x, "pa.readbuffer2~");
+}
+
+//! @brief Compute the windowed-sinc tables (Blackman window).
+static void pa_readbuffer2_init_sinc_tables(void)
+{
+    const double pi = 3.14159265358979323846;
+    int i, j;
+
+    for(i = 0; i < PA_SINC_HALF * PA_SINC_PHASES + 2; ++i)
     {
-        return -1; // no buffer set
+        const double x = (double)i / PA_SINC_PHASES;
+        const double t = x / PA_SINC_HALF;
+        double value = 0.;
+
+        if(t < 1.)
+        {
+            const double window = 0.42 + 0.5 * cos(pi * t) + 0.08 * cos(2. * pi * t);
+            const double sinc = (i == 0) ? 1. : sin(pi * PA_SINC_CUTOFF * x) / (pi * PA_SINC_CUTOFF * x);
+            value = PA_SINC_CUTOFF * sinc * window;
+        }
+
+        pa_readbuffer2_sinc_table[i] = (float)value;
     }
-    
-    a = (t_garray*)pd_findbyclass(x->m_name, garray_class);
-    
-    if(!a)
+
+    for(i = 0; i <= PA_SINC_PHASES; ++i)
     {
-        pd_error(x, "pa.readbuffer1~: %s no such array.", x->m_name->s_name);
-        return -1;
+        double sum = 0.;
+
+        // tap j reads the sample at (j - PA_SINC_HALF + 1) from the integer part of the position
+        for(j = 0; j < PA_SINC_TAPS; ++j)
+        {
+            const int distance = abs((j - PA_SINC_HALF + 1) * PA_SINC_PHASES - i);
+            pa_readbuffer2_sinc_rows[i][j] = pa_readbuffer2_sinc_table[distance];
+            sum += pa_readbuffer2_sinc_rows[i][j];
+        }
+
+        for(j = 0; j < PA_SINC_TAPS; ++j)
+        {
+            pa_readbuffer2_sinc_rows[i][j] = (float)(pa_readbuffer2_sinc_rows[i][j] / sum);
+        }
     }
-    
-    const int err = garray_getfloatwords(a, &x->m_size, &x->m_buffer);
-    if(!err)
+}
+
+static void pa_readbuffer2_tilde_set_interp(t_pa_readbuffer2* x, t_symbol* s)
+{
+    if(strcmp(s->s_name, "linear") == 0)
     {
-        pd_error(x, "pa.readbuffer1~: %s array is empty.", x->m_name->s_name);
-        return -1;
+        x->m_interp = PA_READBUFFER2_INTERP_LINEAR;
+    }
+    else if(strcmp(s->s_name, "sinc") == 0)
+    {
+        x->m_interp = PA_READBUFFER2_INTERP_SINC;
+    }
+    else
+    {
+        pd_error(x, "pa.readbuffer2~: unknown interpolation %s (linear or sinc)", s->s_name);
     }
-    
-    // mark the array as used by the DSP
-    // doing so will cause the prepare method to be called when the array is removed
-    garray_usedindsp(a);
-    
-    return 0;
 }
 
-static t_int* pa_readbuffer2_perform(t_int *w)
+static inline int pa_readbuffer2_wrap(int idx, int size)
+{
+    idx %= size;
+    return (idx < 0) ? (idx + size) : idx;
+}
+
+//! @brief Interpolate at a position with the polyphase table (speeds up to 1).
+//! @details The weights of the two nearest fractional positions are blended, then convolved with the samples.
+static inline float pa_readbuffer2_sinc_polyphase(t_float const* buffer, int stride, int size, int idx, float frac)
+{
+    const float phase = frac * PA_SINC_PHASES;
+    int row = (int)phase;
+    float blend = phase - row;
+
+    // frac may round up to 1. (the last row)
+    if(row >= PA_SINC_PHASES)
+    {
+        row = PA_SINC_PHASES - 1;
+        blend = 1.f;
+    }
+
+    float const* w1 = pa_readbuffer2_sinc_rows[row];
+    float const* w2 = pa_readbuffer2_sinc_rows[row + 1];
+    const int first = idx - PA_SINC_HALF + 1;
+    float weights[PA_SINC_TAPS];
+    float samples[PA_SINC_TAPS];
+    int j;
+
+    for(j = 0; j < PA_SINC_TAPS; ++j)
+    {
+        weights[j] = w1[j] + blend * (w2[j] - w1[j]);
+    }
+
+    // gather the samples first (they aren't contiguous, see pa_array.h), so that the convolution can be vectorized
+    if(first >= 0 && first + PA_SINC_TAPS <= size)
+    {
+        for(j = 0; j < PA_SINC_TAPS; ++j)
+        {
+            samples[j] = buffer[(first + j) * stride];
+        }
+    }
+    else
+    {
+        for(j = 0; j < PA_SINC_TAPS; ++j)
+        {
+            samples[j] = buffer[pa_readbuffer2_wrap(first + j, size) * stride];
+        }
+    }
+
+    // four partial sums, the compiler can't reorder a single float sum to vectorize it
+    float sums[4] = {0.f, 0.f, 0.f, 0.f};
+    for(j = 0; j < PA_SINC_TAPS; j += 4)
+    {
+        sums[0] += samples[j] * weights[j];
+        sums[1] += samples[j + 1] * weights[j + 1];
+        sums[2] += samples[j + 2] * weights[j + 2];
+        sums[3] += samples[j + 3] * weights[j + 3];
+    }
+
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+//! @brief Interpolate at a position with the kernel stretched by factor (speeds above 1).
+//! @details The cutoff is lowered by the same factor, so that the frequencies that would fold back
+//! above the Nyquist frequency are removed. The cost grows with the factor.
+static inline float pa_readbuffer2_sinc_stretched(t_float const* buffer, int stride, int size, float position, float factor)
+{
+    const float width = PA_SINC_HALF * factor;
+    const float scale = PA_SINC_PHASES / factor;
+    const int first = (int)floorf(position - width) + 1;
+    const int last = (int)floorf(position + width);
+    float sum = 0.f;
+    float norm = 0.f;
+    int k;
+
+    const int inside = (first >= 0 && last < size);
+
+    for(k = first; k <= last; ++k)
+    {
+        const float distance = fabsf(k - position) * scale;
+        const int i = (int)distance;
+        const float weight = pa_readbuffer2_sinc_table[i]
+                           + (distance - i) * (pa_readbuffer2_sinc_table[i + 1] - pa_readbuffer2_sinc_table[i]);
+
+        sum += buffer[(inside ? k : pa_readbuffer2_wrap(k, size)) * stride] * weight;
+        norm += weight;
+    }
+
+    return (norm > 0.f) ? (sum / norm) : 0.f;
+}
+
+//! @brief Read the array at the speeds of the block with windowed-sinc interpolation.
+//! @details The blocks whose speeds are all within [-1, 1] use the polyphase table only.
+static void pa_readbuffer2_perform_sinc(t_pa_readbuffer2* x, t_sample const* in, t_sample* out, int n)
+{
+    const int buffersize = x->m_array.m_size;
+    const float invsize = 1.f / buffersize;
+    t_float const* buffer = x->m_array.m_samples;
+    const int stride = x->m_array.m_stride;
+    float phase = x->m_phase;
+    float maxspeed = 0.f;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const float speed = fabsf(in[i]);
+        if(speed > maxspeed) maxspeed = speed;
+    }
+
+    for(i = 0; i < n; ++i)
+    {
+        const float speed = in[i];
+
+        if(speed != 0.f)
+        {
+            // wrap phase between 0. and 1. (the speed may be higher than the size of the array),
+            // a tiny negative phase rounds up to 1. when it is wrapped
+            if(phase >= 1.f || phase < 0.f)
+            {
+                phase -= floorf(phase);
+                if(phase >= 1.f) phase = 0.f;
+            }
+
+            const float tphase = phase * buffersize;
+            int idx = (int)tphase;
+            if(idx >= buffersize) idx = buffersize - 1;
+
+            if(maxspeed <= 1.f)
+            {
+                out[i] = pa_readbuffer2_sinc_polyphase(buffer, stride, buffersize, idx, tphase - idx);
+            }
+            else
+            {
+                float factor = fabsf(speed);
+                if(factor < 1.f) factor = 1.f;
+                if(factor > PA_SINC_MAX_FACTOR) factor = PA_SINC_MAX_FACTOR;
+                out[i] = pa_readbuffer2_sinc_stretched(buffer, stride, buffersize, tphase, factor);
+            }
+
+            // increment phase (speed * sr / buffersize / sr)
+            phase += speed * invsize;
+        }
+        else
+        {
+            out[i] = 0.f;
+        }
+    }
+
+    x->m_phase = phase;
+}
+
+//! @brief Read the array at the speeds of the block, there is no validity check in the loop.
+//! @details It is inlined for the stride of the Pd arrays, so that their samples are read with a constant stride.
+static inline void pa_readbuffer2_perform_valid(t_pa_readbuffer2* x, int stride, t_sample const* in, t_sample* out, int n, float sr)
 {
-    t_pa_readbuffer2* x = (t_pa_readbuffer2 *)(w[1]);
-    t_sample* in   = (t_sample *)(w[2]);
-    t_sample* out  = (t_sample *)(w[3]);
-    size_t n       = (size_t)(w[4]);
-    float sr       = (float)(w[5]);
-    
     float speed = 0.f;
     float freq = 0.f;
     float phase = x->m_phase;
@@ -82,20 +285,20 @@ static t_int* pa_readbuffer2_perform(t_int *w)
     float y1, y2, frac;
     
     // buffer
-    const int buffersize = x->m_size;
-    t_word const* buffer = x->m_buffer;
+    const int buffersize = x->m_array.m_size;
+    t_float const* buffer = x->m_array.m_samples;
     
     while(n--)
     {
         speed = *in++;
         
-        if(speed != 0.f && buffersize > 0 && x->m_buffer)
+        if(speed != 0.f)
         {
             freq = sr / buffersize * speed;
             
             // wrap phase between 0. and 1.
             if(phase >= 1.f) { phase -= 1.f; }
-            else if(phase < 0.f) { phase += 1.f; }
+            else if(phase < 0.f) { phase += 1.f; if(phase >= 1.f) phase = 0.f; }
             
             tphase = phase * buffersize;
             
@@ -107,8 +310,8 @@ static t_int* pa_readbuffer2_perform(t_int *w)
             
             frac = tphase - idx_1;
             
-            y1 = buffer[idx_1].w_float;
-            y2 = buffer[idx_2].w_float;
+            y1 = buffer[idx_1 * stride];
+            y2 = buffer[idx_2 * stride];
             
             // linear interpolation
             *out++ = y1 + frac * (y2 - y1);
@@ -123,6 +326,38 @@ static t_int* pa_readbuffer2_perform(t_int *w)
     }
     
     x->m_phase = phase;
+}
+
+static t_int* pa_readbuffer2_perform(t_int *w)
+{
+    t_pa_readbuffer2* x = (t_pa_readbuffer2 *)(w[1]);
+    t_sample* in   = (t_sample *)(w[2]);
+    t_sample* out  = (t_sample *)(w[3]);
+    int n          = (int)(w[4]);
+    float sr       = (float)(w[5]);
+    
+    // the array may be set or unset by a message between two dsp builds, so it's checked once per block.
+    if(!pa_array_isvalid(&x->m_array))
+    {
+        memset(out, 0, sizeof(t_sample) * n);
+    }
+    else if(x->m_interp == PA_READBUFFER2_INTERP_SINC)
+    {
+        pa_readbuffer2_perform_sinc(x, in, out, n);
+    }
+    else if(x->m_array.m_stride == PA_ARRAY_WORD_STRIDE)
+    {
+        pa_readbuffer2_perform_valid(x, PA_ARRAY_WORD_STRIDE, in, out, n, sr);
+    }
+    else
+    {
+        pa_readbuffer2_perform_valid(x, x->m_array.m_stride, in, out, n, sr);
+    }
+    
+    if(x->m_array.m_source)
+    {
+        pa_mmapsource_hint(x->m_array.m_source, (int)((x->m_phase - floorf(x->m_phase)) * x->m_array.m_size));
+    }
     
     return (w+6);
 }
@@ -130,7 +365,7 @@ static t_int* pa_readbuffer2_perform(t_int *w)
 
 static void pa_readbuffer2_tilde_dsp(t_pa_readbuffer2* x, t_signal **sp)
 {
-    pa_readbuffer2_tilde_set_buffer(x, x->m_name);
+    pa_array_update(&x->m_array, x, "pa.readbuffer2~");
     
     dsp_add(pa_readbuffer2_perform, 5,
             (t_int)x,
@@ -146,6 +381,7 @@ static void *pa_readbuffer2_tilde_new(t_symbol* buffer_name)
     
     if(x)
     {
+        x->m_interp = PA_READBUFFER2_INTERP_LINEAR;
         pa_readbuffer2_tilde_set_buffer(x, buffer_name);
         
         x->m_out = outlet_new((t_object *)x, &s_signal);
@@ -168,7 +404,10 @@ extern void setup_pa0x2ereadbuffer2_tilde(void)
     {
         class_addmethod(c, (t_method)pa_readbuffer2_tilde_dsp,           gensym("dsp"),        A_CANT);
         class_addmethod(c, (t_method)pa_readbuffer2_tilde_set_buffer,    gensym("set"),        A_DEFSYM, 0);
+        class_addmethod(c, (t_method)pa_readbuffer2_tilde_set_interp,    gensym("interp"),     A_SYMBOL, 0);
         CLASS_MAINSIGNALIN(c, t_pa_readbuffer2, m_f);
+        
+        pa_readbuffer2_init_sinc_tables();
     }
     
     pa_readbuffer2_tilde_class = c;
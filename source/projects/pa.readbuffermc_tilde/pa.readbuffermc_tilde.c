@@ -0,0 +1,317 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+//! @brief Read samples in several Pd arrays (or in the channels of a pa.mmapsource) at a given speed
+//! @details The multichannel version of pa.readbuffer2~: the channels share a single position,
+//! which is computed once per sample for all of them, then each channel is interpolated
+//! for the whole block from the same indices. The channels can't drift apart.
+
+#include <m_pd.h>
+
+#include <stdlib.h> // malloc, calloc, free...
+#include <string.h> // memset
+#include <math.h>   // floor
+
+#include <pa_array.h>
+
+static t_class* pa_readbuffermc_tilde_class;
+
+typedef struct _pa_readbuffermc
+{
+    t_object    m_obj;
+
+    // position in frames, the same for all the channels
+    double      m_position;
+
+    // one array per channel, all of them are read with the size of the shortest one
+    int         m_channels;
+    t_pa_array* m_arrays;
+    int         m_size;
+
+    // one block of positions, shared by the channels
+    int*        m_indices;
+    int*        m_nexts;        // index of the second point of the interpolation
+    float*      m_fracs;
+    float*      m_gains;        // 0 where the speed is 0 (nothing is read), 1 otherwise
+
+    t_outlet**  m_outlets;
+    t_sample**  m_outputs;
+    t_int*      m_dspvec;
+
+    t_float     m_f;
+
+} t_pa_readbuffermc;
+
+//! @brief The number of frames read: the size of the shortest array, 0 if there is no array to read.
+static void pa_readbuffermc_tilde_update_size(t_pa_readbuffermc* x)
+{
+    int size = 0;
+    int c;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        t_pa_array const* array = x->m_arrays + c;
+
+        if(pa_array_isvalid(array) && (size == 0 || array->m_size < size))
+        {
+            size = array->m_size;
+        }
+    }
+
+    x->m_size = size;
+}
+
+//! @brief Set the arrays from a list of names, or from the name of a pa.mmapsource followed by a number of channels.
+static void pa_readbuffermc_tilde_set_arrays(t_pa_readbuffermc* x, t_symbol* s, int argc, t_atom* argv)
+{
+    const int interleaved = (argc >= 2 && argv[0].a_type == A_SYMBOL && argv[1].a_type == A_FLOAT);
+    int c;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        t_pa_array* array = x->m_arrays + c;
+        t_symbol* name = &s_;
+
+        if(interleaved)
+        {
+            // the channels of a source follow its selected channel
+            name = argv[0].a_w.w_symbol;
+            array->m_offset = c;
+        }
+        else
+        {
+            if(c < argc && argv[c].a_type == A_SYMBOL) name = argv[c].a_w.w_symbol;
+            array->m_offset = 0;
+        }
+
+        pa_array_set(array, name, x, "pa.readbuffermc~");
+    }
+
+    pa_readbuffermc_tilde_update_size(x);
+}
+
+//! @brief Compute the positions of the block, before anything is written to the outputs (one of them may be the input vector).
+static void pa_readbuffermc_compute_positions(t_pa_readbuffermc* x, t_sample const* in, int n)
+{
+    const int size = x->m_size;
+    double position = x->m_position;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const t_sample speed = in[i];
+
+        if(speed != 0.f)
+        {
+            // wrap the position in the arrays (the speed may be higher than their size)
+            if(position >= size || position < 0.) position -= floor(position / size) * size;
+
+            int idx = (int)position;
+            if(idx >= size) { idx = 0; position = 0.; } // rounding
+
+            x->m_indices[i] = idx;
+            x->m_nexts[i] = (idx + 1 < size) ? (idx + 1) : 0;
+            x->m_fracs[i] = (float)(position - idx);
+            x->m_gains[i] = 1.f;
+
+            position += speed;
+        }
+        else
+        {
+            x->m_indices[i] = 0;
+            x->m_nexts[i] = 0;
+            x->m_fracs[i] = 0.f;
+            x->m_gains[i] = 0.f;
+        }
+    }
+
+    x->m_position = position;
+}
+
+//! @brief Interpolate one channel at the positions of the block.
+//! @details It is inlined for the stride of the Pd arrays, so that their samples are read with a constant stride.
+static inline void pa_readbuffermc_read_channel(t_pa_readbuffermc const* x, t_float const* samples, int stride,
+                                                t_sample* out, int n)
+{
+    int const* indices = x->m_indices;
+    int const* nexts = x->m_nexts;
+    float const* fracs = x->m_fracs;
+    float const* gains = x->m_gains;
+    int i;
+
+    for(i = 0; i < n; ++i)
+    {
+        const float y1 = samples[indices[i] * stride];
+        const float y2 = samples[nexts[i] * stride];
+        out[i] = gains[i] * (y1 + fracs[i] * (y2 - y1));
+    }
+}
+
+static t_int* pa_readbuffermc_perform(t_int *w)
+{
+    t_pa_readbuffermc* x = (t_pa_readbuffermc *)(w[1]);
+    int n                = (int)(w[2]);
+    t_sample* in         = (t_sample *)(w[3]);
+    int c;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        x->m_outputs[c] = (t_sample *)(w[c + 4]);
+    }
+
+    // the arrays may be set or unset by a message between two dsp builds, so they're checked once per block.
+    if(x->m_size == 0)
+    {
+        for(c = 0; c < x->m_channels; ++c)
+        {
+            memset(x->m_outputs[c], 0, sizeof(t_sample) * n);
+        }
+
+        return (w + (4 + x->m_channels));
+    }
+
+    pa_readbuffermc_compute_positions(x, in, n);
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        t_pa_array const* array = x->m_arrays + c;
+
+        if(!pa_array_isvalid(array))
+        {
+            memset(x->m_outputs[c], 0, sizeof(t_sample) * n);
+        }
+        else if(array->m_stride == PA_ARRAY_WORD_STRIDE)
+        {
+            pa_readbuffermc_read_channel(x, array->m_samples, PA_ARRAY_WORD_STRIDE, x->m_outputs[c], n);
+        }
+        else
+        {
+            pa_readbuffermc_read_channel(x, array->m_samples, array->m_stride, x->m_outputs[c], n);
+        }
+
+        if(array->m_source)
+        {
+            pa_mmapsource_hint(array->m_source, x->m_indices[n - 1]);
+        }
+    }
+
+    return (w + (4 + x->m_channels));
+}
+
+static void pa_readbuffermc_tilde_dsp(t_pa_readbuffermc* x, t_signal** sp)
+{
+    const int n = sp[0]->s_n;
+    int c;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        pa_array_update(x->m_arrays + c, x, "pa.readbuffermc~");
+    }
+
+    pa_readbuffermc_tilde_update_size(x);
+
+    // one block of positions
+    free(x->m_indices);
+    free(x->m_nexts);
+    free(x->m_fracs);
+    free(x->m_gains);
+    x->m_indices = (int*)malloc(sizeof(int) * n);
+    x->m_nexts = (int*)malloc(sizeof(int) * n);
+    x->m_fracs = (float*)malloc(sizeof(float) * n);
+    x->m_gains = (float*)malloc(sizeof(float) * n);
+
+    if(!x->m_indices || !x->m_nexts || !x->m_fracs || !x->m_gains)
+    {
+        pd_error(x, "pa.readbuffermc~: can't allocate the block buffers");
+        return;
+    }
+
+    x->m_dspvec[0] = (t_int)x;
+    x->m_dspvec[1] = (t_int)n;
+    x->m_dspvec[2] = (t_int)sp[0]->s_vec;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        x->m_dspvec[3 + c] = (t_int)sp[c + 1]->s_vec;
+    }
+
+    dsp_addv(pa_readbuffermc_perform, 3 + x->m_channels, x->m_dspvec);
+}
+
+static void* pa_readbuffermc_tilde_new(t_symbol* s, int argc, t_atom* argv)
+{
+    t_pa_readbuffermc* x = (t_pa_readbuffermc *)pd_new(pa_readbuffermc_tilde_class);
+
+    if(x)
+    {
+        int channels = 0;
+        int c;
+
+        // a list of arrays, or a source and a number of channels
+        if(argc >= 2 && argv[0].a_type == A_SYMBOL && argv[1].a_type == A_FLOAT)
+        {
+            channels = (int)argv[1].a_w.w_float;
+        }
+        else
+        {
+            while(channels < argc && argv[channels].a_type == A_SYMBOL) channels++;
+        }
+
+        if(channels < 1) channels = 1;
+
+        x->m_channels = channels;
+        x->m_arrays = (t_pa_array*)calloc(channels, sizeof(t_pa_array));
+        x->m_outlets = (t_outlet**)malloc(sizeof(t_outlet*) * channels);
+        x->m_outputs = (t_sample**)malloc(sizeof(t_sample*) * channels);
+
+        // object + vecsize + inlet + outlets
+        x->m_dspvec = (t_int*)malloc(sizeof(t_int) * (3 + channels));
+
+        for(c = 0; c < channels; ++c)
+        {
+            x->m_outlets[c] = outlet_new((t_object *)x, &s_signal);
+        }
+
+        pa_readbuffermc_tilde_set_arrays(x, s, argc, argv);
+    }
+
+    return x;
+}
+
+static void pa_readbuffermc_tilde_free(t_pa_readbuffermc* x)
+{
+    int c;
+
+    for(c = 0; c < x->m_channels; ++c)
+    {
+        outlet_free(x->m_outlets[c]);
+    }
+
+    free(x->m_outlets);
+    free(x->m_outputs);
+    free(x->m_arrays);
+    free(x->m_dspvec);
+
+    free(x->m_indices);
+    free(x->m_nexts);
+    free(x->m_fracs);
+    free(x->m_gains);
+}
+
+extern void setup_pa0x2ereadbuffermc_tilde(void)
+{
+    t_class* c = class_new(gensym("pa.readbuffermc~"),
+                           (t_newmethod)pa_readbuffermc_tilde_new, (t_method)pa_readbuffermc_tilde_free,
+                           sizeof(t_pa_readbuffermc), CLASS_DEFAULT, A_GIMME, 0);
+    if(c)
+    {
+        class_addmethod(c, (t_method)pa_readbuffermc_tilde_dsp,         gensym("dsp"),  A_CANT);
+        class_addmethod(c, (t_method)pa_readbuffermc_tilde_set_arrays,  gensym("set"),  A_GIMME, 0);
+        CLASS_MAINSIGNALIN(c, t_pa_readbuffermc, m_f);
+    }
+
+    pa_readbuffermc_tilde_class = c;
+}
@@ -0,0 +1,116 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                     SPSC RING                                    //
+    // ================================================================================ //
+
+    //! @brief A lock-free ring buffer with a single producer and a single consumer.
+    //! @details The producer and the consumer each own one index and only read the other one,
+    //! so no lock is needed: the audio thread never waits for the thread that reads the file.
+    //! The capacity is rounded up to a power of two so that the indices are wrapped with a bitmask.
+    //! The consumer can look at the available samples before releasing them (see peek() and release()).
+    template<class SampleType>
+    class SpscRing
+    {
+    public: // methods
+
+        using sample_t = SampleType;
+
+        //! @brief Constructor
+        explicit SpscRing(size_t capacity)
+        {
+            size_t pow2 = 1;
+            while(pow2 < capacity) pow2 <<= 1;
+
+            m_samples.resize(pow2, sample_t(0.));
+            m_mask = pow2 - 1;
+        }
+
+        //! @brief Returns the maximum number of samples in the ring
+        size_t capacity() const
+        {
+            return m_samples.size();
+        }
+
+        //! @brief Empty the ring
+        //! @details Neither the producer nor the consumer must run at the same time.
+        void reset()
+        {
+            m_write.store(0, std::memory_order_relaxed);
+            m_read.store(0, std::memory_order_relaxed);
+        }
+
+        // ---------------------------------------------------------------------------- //
+        //                                    PRODUCER                                  //
+        // ---------------------------------------------------------------------------- //
+
+        //! @brief Returns the number of samples that can be pushed
+        size_t writable() const
+        {
+            const size_t write = m_write.load(std::memory_order_relaxed);
+            const size_t read = m_read.load(std::memory_order_acquire);
+            return capacity() - (write - read);
+        }
+
+        //! @brief Push samples, the caller must check that there is enough room (see writable()).
+        void push(sample_t const* samples, size_t count)
+        {
+            const size_t write = m_write.load(std::memory_order_relaxed);
+
+            for(size_t i = 0; i < count; ++i)
+            {
+                m_samples[(write + i) & m_mask] = samples[i];
+            }
+
+            // publish the samples after they are written
+            m_write.store(write + count, std::memory_order_release);
+        }
+
+        // ---------------------------------------------------------------------------- //
+        //                                    CONSUMER                                  //
+        // ---------------------------------------------------------------------------- //
+
+        //! @brief Returns the number of samples that can be read
+        size_t readable() const
+        {
+            const size_t read = m_read.load(std::memory_order_relaxed);
+            const size_t write = m_write.load(std::memory_order_acquire);
+            return write - read;
+        }
+
+        //! @brief Returns the sample at a given offset from the oldest one, offset must be lower than readable().
+        sample_t peek(size_t offset) const
+        {
+            return m_samples[(m_read.load(std::memory_order_relaxed) + offset) & m_mask];
+        }
+
+        //! @brief Release the count oldest samples, count must not be greater than readable().
+        void release(size_t count)
+        {
+            const size_t read = m_read.load(std::memory_order_relaxed);
+            m_read.store(read + count, std::memory_order_release);
+        }
+
+    private: // variables
+
+        std::vector<sample_t>   m_samples;
+        size_t                  m_mask = 0;
+
+        // the indices only grow (size_t wraps around), they are masked to access the samples
+        // and kept on separate cache lines to avoid false sharing between the two threads
+        // (padding rather than alignas, over-aligned new needs c++17).
+        std::atomic<size_t>     m_write {0};
+        char                    m_padding[64];
+        std::atomic<size_t>     m_read {0};
+    };
+}
@@ -0,0 +1,444 @@
+/*
+ // Copyright (c) 2016 Eliott Paris.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "SpscRing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace paccpp
+{
+    // ================================================================================ //
+    //                                    SOUND FILE                                    //
+    // ================================================================================ //
+
+    //! @brief Reads the first channel of a sound file as floats, one chunk at a time.
+    //! @details Supports WAV files (16, 24 or 32-bit integer and 32-bit float samples)
+    //! and raw files of 32-bit float samples (one channel). Multi-byte samples are read
+    //! as little-endian values, the host is expected to be little-endian.
+    class SoundFile
+    {
+    public: // methods
+
+        //! Constructor
+        SoundFile() = default;
+
+        //! Destructor
+        ~SoundFile()
+        {
+            close();
+        }
+
+        SoundFile(SoundFile const&) = delete;
+        SoundFile& operator=(SoundFile const&) = delete;
+
+        //! @brief Open a file and move to its first frame
+        //! @return An empty string on success, the error otherwise.
+        std::string open(std::string const& path, bool raw)
+        {
+            close();
+
+            m_file = std::fopen(path.c_str(), "rb");
+            if(!m_file)
+            {
+                return "can't open " + path;
+            }
+
+            const std::string error = raw ? readRawHeader() : readWavHeader();
+            if(!error.empty())
+            {
+                close();
+                return error;
+            }
+
+            rewind();
+            return std::string();
+        }
+
+        //! @brief Close the file
+        void close()
+        {
+            if(m_file)
+            {
+                std::fclose(m_file);
+                m_file = nullptr;
+            }
+
+            m_frames = 0;
+        }
+
+        //! @brief Returns the number of frames of the file
+        size_t frames() const
+        {
+            return m_frames;
+        }
+
+        //! @brief Move to the first frame
+        void rewind()
+        {
+            if(m_file)
+            {
+                std::fseek(m_file, m_data_offset, SEEK_SET);
+                m_position = 0;
+            }
+        }
+
+        //! @brief Read up to count frames from the current position
+        //! @return The number of frames read, 0 at the end of the file.
+        size_t read(float* out, size_t count)
+        {
+            if(!m_file) return 0;
+
+            if(count > m_frames - m_position)
+            {
+                count = m_frames - m_position;
+            }
+
+            m_bytes.resize(count * m_frame_bytes);
+            count = std::fread(m_bytes.data(), m_frame_bytes, count, m_file);
+
+            unsigned char const* frame = m_bytes.data();
+            for(size_t i = 0; i < count; ++i, frame += m_frame_bytes)
+            {
+                out[i] = decode(frame);
+            }
+
+            m_position += count;
+            return count;
+        }
+
+    private: // methods
+
+        enum class Format
+        {
+            Int16,
+            Int24,
+            Int32,
+            Float32
+        };
+
+        static uint32_t readLE(unsigned char const* bytes, int count)
+        {
+            uint32_t value = 0;
+            for(int i = count - 1; i >= 0; --i)
+            {
+                value = (value << 8) | bytes[i];
+            }
+            return value;
+        }
+
+        float decode(unsigned char const* bytes) const
+        {
+            switch(m_format)
+            {
+                case Format::Int16:
+                    return int16_t(readLE(bytes, 2)) * (1.f / 32768.f);
+                case Format::Int24:
+                    // shift the 24 bits to the top of an int32 to keep the sign
+                    return int32_t(readLE(bytes, 3) << 8) * (1.f / 2147483648.f);
+                case Format::Int32:
+                    return int32_t(readLE(bytes, 4)) * (1.f / 2147483648.f);
+                case Format::Float32:
+                default:
+                {
+                    float value;
+                    std::memcpy(&value, bytes, sizeof(float));
+                    return value;
+                }
+            }
+        }
+
+        std::string readRawHeader()
+        {
+            std::fseek(m_file, 0, SEEK_END);
+            const long size = std::ftell(m_file);
+
+            m_format = Format::Float32;
+            m_frame_bytes = sizeof(float);
+            m_data_offset = 0;
+            m_frames = (size > 0) ? size_t(size) / m_frame_bytes : 0;
+
+            return m_frames ? std::string() : std::string("empty file");
+        }
+
+        std::string readWavHeader()
+        {
+            unsigned char header[12];
+            if(std::fread(header, 1, 12, m_file) != 12
+               || std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0)
+            {
+                return "not a WAV file (use the raw flag for raw float files)";
+            }
+
+            int channels = 0, bits = 0, tag = 0;
+            bool has_format = false;
+
+            unsigned char chunk[8];
+            while(std::fread(chunk, 1, 8, m_file) == 8)
+            {
+                const uint32_t size = readLE(chunk + 4, 4);
+                const long next = std::ftell(m_file) + long(size + (size & 1)); // chunks are padded to an even size
+
+                if(std::memcmp(chunk, "fmt ", 4) == 0)
+                {
+                    unsigned char fmt[26] = {0};
+                    if(size < 16 || std::fread(fmt, 1, size < 26 ? size : 26, m_file) < 16)
+                    {
+                        return "bad fmt chunk";
+                    }
+
+                    tag = int(readLE(fmt, 2));
+                    channels = int(readLE(fmt + 2, 2));
+                    bits = int(readLE(fmt + 14, 2));
+
+                    // WAVE_FORMAT_EXTENSIBLE: the format tag is the start of the sub format
+                    if(tag == 0xFFFE && size >= 26)
+                    {
+                        tag = int(readLE(fmt + 24, 2));
+                    }
+
+                    has_format = true;
+                }
+                else if(std::memcmp(chunk, "data", 4) == 0)
+                {
+                    if(!has_format || channels < 1)
+                    {
+                        return "no fmt chunk before the data";
+                    }
+
+                    if(tag == 1 && bits == 16)       m_format = Format::Int16;
+                    else if(tag == 1 && bits == 24)  m_format = Format::Int24;
+                    else if(tag == 1 && bits == 32)  m_format = Format::Int32;
+                    else if(tag == 3 && bits == 32)  m_format = Format::Float32;
+                    else return "unsupported sample format (16, 24 or 32-bit integer, 32-bit float)";
+
+                    m_frame_bytes = size_t(channels) * (bits / 8);
+                    m_data_offset = std::ftell(m_file);
+                    m_frames = size / m_frame_bytes;
+
+                    return m_frames ? std::string() : std::string("empty file");
+                }
+
+                std::fseek(m_file, next, SEEK_SET);
+            }
+
+            return "no data chunk";
+        }
+
+    private: // variables
+
+        std::FILE*                  m_file = nullptr;
+        Format                      m_format = Format::Float32;
+        size_t                      m_frame_bytes = sizeof(float);
+        long                        m_data_offset = 0;
+        size_t                      m_frames = 0;
+        size_t                      m_position = 0;
+        std::vector<unsigned char>  m_bytes;
+    };
+
+    // ================================================================================ //
+    //                                   STREAM READER                                  //
+    // ================================================================================ //
+
+    //! @brief Plays a sound file at a given speed, streamed from the disk.
+    //! @details A background thread reads the file (in a loop) into a lock-free ring,
+    //! the audio thread only reads the ring and never waits: if the disk is late,
+    //! the missing samples are output as zeros and counted (see underruns()).
+    //! The memory used doesn't depend on the length of the file.
+    //! open() and close() must be called from the thread that calls process().
+    class StreamReader
+    {
+    public: // methods
+
+        using sample_t = float;
+
+        //! @brief Constructor
+        //! @param capacity The number of frames of the ring
+        explicit StreamReader(size_t capacity)
+        : m_ring(capacity)
+        {
+            ;
+        }
+
+        //! @brief Destructor
+        ~StreamReader()
+        {
+            close();
+        }
+
+        StreamReader(StreamReader const&) = delete;
+        StreamReader& operator=(StreamReader const&) = delete;
+
+        //! @brief Open a file and start reading it in the background
+        //! @return An empty string on success, the error otherwise.
+        std::string open(std::string const& path, bool raw)
+        {
+            close();
+
+            const std::string error = m_file.open(path, raw);
+            if(!error.empty())
+            {
+                return error;
+            }
+
+            m_running.store(true);
+            m_thread = std::thread(&StreamReader::run, this);
+            return std::string();
+        }
+
+        //! @brief Stop the background thread and close the file
+        void close()
+        {
+            m_running.store(false);
+
+            if(m_thread.joinable())
+            {
+                m_thread.join();
+            }
+
+            m_file.close();
+            m_ring.reset();
+            m_position = 0.;
+            m_started = false;
+            m_underruns = 0;
+        }
+
+        //! @brief Returns true if a file is streamed
+        bool isOpen() const
+        {
+            return m_thread.joinable();
+        }
+
+        //! @brief Returns the number of frames of the file
+        size_t frames() const
+        {
+            return m_file.frames();
+        }
+
+        //! @brief Returns the number of frames ready to be played
+        size_t buffered() const
+        {
+            return m_ring.readable();
+        }
+
+        //! @brief Returns the capacity of the ring in frames
+        size_t capacity() const
+        {
+            return m_ring.capacity();
+        }
+
+        //! @brief Returns the number of samples output as zeros because the disk was late
+        size_t underruns() const
+        {
+            return m_underruns;
+        }
+
+        //! @brief Play a block of samples
+        //! @details Like pa.readbuffer2~, each speed moves the playback by that many frames of the file
+        //! (with linear interpolation) and a speed of 0 outputs 0. The stream only moves forward,
+        //! negative speeds also output 0. speeds and outs may be the same vector.
+        void process(sample_t const* speeds, sample_t* outs, long vecsize)
+        {
+            const size_t available = m_ring.readable();
+            double position = m_position;
+
+            if(available > 1)
+            {
+                m_started = true;
+            }
+
+            for(long i = 0; i < vecsize; ++i)
+            {
+                const sample_t speed = speeds[i];
+
+                if(speed > sample_t(0.))
+                {
+                    const size_t idx = size_t(position);
+
+                    if(idx + 1 < available)
+                    {
+                        const sample_t frac = sample_t(position - double(idx));
+                        const sample_t y1 = m_ring.peek(idx);
+                        const sample_t y2 = m_ring.peek(idx + 1);
+
+                        outs[i] = y1 + frac * (y2 - y1);
+                        position += speed;
+                    }
+                    else
+                    {
+                        outs[i] = sample_t(0.);
+                        if(m_started) ++m_underruns;
+                    }
+                }
+                else
+                {
+                    outs[i] = sample_t(0.);
+                }
+            }
+
+            // give the frames that have been played back to the reader thread,
+            // the speeds above 1 may have skipped frames that are not in the ring yet:
+            // the position keeps them and they are released in a next block
+            const size_t skipped = size_t(position);
+            const size_t played = (skipped < available) ? skipped : available;
+            m_ring.release(played);
+            m_position = position - double(played);
+        }
+
+    private: // methods
+
+        //! @brief The loop of the background thread
+        void run()
+        {
+            std::vector<sample_t> chunk(chunk_size);
+            bool rewound = false;
+
+            while(m_running.load())
+            {
+                if(m_ring.writable() < chunk_size)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+
+                const size_t count = m_file.read(chunk.data(), chunk_size);
+
+                if(count == 0)
+                {
+                    // loop, if nothing can be read from the start either, wait instead of spinning.
+                    if(rewound) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    m_file.rewind();
+                    rewound = true;
+                    continue;
+                }
+
+                rewound = false;
+
+                m_ring.push(chunk.data(), count);
+            }
+        }
+
+    private: // variables
+
+        static const size_t chunk_size = 4096;
+
+        SoundFile           m_file;
+        SpscRing<sample_t>  m_ring;
+        std::thread         m_thread;
+        std::atomic<bool>   m_running {false};
+
+        // only used by the audio thread
+        double              m_position = 0.;    // position from the oldest frame of the ring
+        bool                m_started = false;  // the first frames have been read
+        size_t              m_underruns = 0;
+    };
+}
@@ -0,0 +1,153 @@
+/*
+// Copyright (c) 2016 Eliott Paris.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+//! @brief Plays a sound file from the disk at a given speed
+//! @details the streaming counterpart of the [pa.readbuffer2~] object
+
+#include <m_pd.h>
+
+#include <cstring>
+#include <string>
+
+#include "StreamReader.hpp"
+using paccpp::StreamReader;
+
+static t_class *pa_readstream_tilde_class;
+
+// number of frames read ahead (about 3 seconds at 44.1kHz)
+static const size_t pa_readstream_ring_size = 131072;
+
+typedef struct _pa_readstream_tilde
+{
+    t_object    m_obj;
+
+    // store a StreamReader pointer
+    StreamReader* m_reader;
+
+    // the directory of the patch, relative paths start from it
+    t_symbol*   m_dir;
+
+    t_outlet*   m_out;
+    t_float     m_f;
+
+} t_pa_readstream_tilde;
+
+//! @brief open <path> [raw] : stream a WAV file (or a raw file of 32-bit floats).
+static void pa_readstream_tilde_open(t_pa_readstream_tilde* x, t_symbol* s, int argc, t_atom* argv)
+{
+    if(argc < 1 || argv[0].a_type != A_SYMBOL)
+    {
+        pd_error(x, "pa.readstream~: open needs a file path");
+        return;
+    }
+
+    const bool raw = (argc >= 2 && argv[1].a_type == A_SYMBOL && std::strcmp(argv[1].a_w.w_symbol->s_name, "raw") == 0);
+
+    std::string path = argv[0].a_w.w_symbol->s_name;
+    if(!path.empty() && path[0] != '/' && !(path.size() > 1 && path[1] == ':') && x->m_dir)
+    {
+        path = std::string(x->m_dir->s_name) + "/" + path;
+    }
+
+    const std::string error = x->m_reader->open(path, raw);
+    if(!error.empty())
+    {
+        pd_error(x, "pa.readstream~: %s", error.c_str());
+    }
+}
+
+static void pa_readstream_tilde_stop(t_pa_readstream_tilde* x)
+{
+    x->m_reader->close();
+}
+
+static void pa_readstream_tilde_status(t_pa_readstream_tilde* x)
+{
+    StreamReader const& reader = *x->m_reader;
+
+    if(!reader.isOpen())
+    {
+        post("pa.readstream~: no file");
+        return;
+    }
+
+    post("pa.readstream~: %lu frames, %lu/%lu frames buffered, %lu underruns",
+         (unsigned long)reader.frames(), (unsigned long)reader.buffered(),
+         (unsigned long)reader.capacity(), (unsigned long)reader.underruns());
+}
+
+static t_int *pa_readstream_tilde_perform(t_int* w)
+{
+    t_pa_readstream_tilde* x = (t_pa_readstream_tilde*)(w[1]);
+
+    t_sample const* ins  = (t_sample *)(w[2]);
+    t_sample*       outs = (t_sample *)(w[3]);
+
+    int vecsize = (int)(w[4]);
+
+    x->m_reader->process(ins, outs, vecsize);
+
+    return (w+5);
+}
+
+static void pa_readstream_tilde_dsp(t_pa_readstream_tilde* x, t_signal **sp)
+{
+    dsp_add(pa_readstream_tilde_perform, 4,
+            x,
+            sp[0]->s_vec,   // inlet 0
+            sp[1]->s_vec,   // outlet 0
+            sp[0]->s_n);    // vectorsize
+}
+
+static void *pa_readstream_tilde_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_pa_readstream_tilde* x = (t_pa_readstream_tilde*)pd_new(pa_readstream_tilde_class);
+    if(x)
+    {
+        // Note: dont forget to delete it in the free method !
+        x->m_reader = new StreamReader(pa_readstream_ring_size);
+        x->m_dir = canvas_getdir(canvas_getcurrent());
+
+        x->m_out = outlet_new((t_object *)x, &s_signal);
+
+        // the arguments are the ones of the open message
+        if(argc >= 1)
+        {
+            pa_readstream_tilde_open(x, gensym("open"), argc, argv);
+        }
+    }
+
+    return (x);
+}
+
+static void pa_readstream_tilde_free(t_pa_readstream_tilde* x)
+{
+    outlet_free(x->m_out);
+
+    // stops the reader thread
+    delete x->m_reader;
+}
+
+// Note in c++ you need to wrap the setup method in an extern "C" statement.
+extern "C"
+{
+    extern void setup_pa0x2ereadstream_tilde(void)
+    {
+        t_class* c = class_new(gensym("pa.readstream~"),
+                               (t_newmethod)pa_readstream_tilde_new, (t_method)pa_readstream_tilde_free,
+                               sizeof(t_pa_readstream_tilde), CLASS_DEFAULT, A_GIMME, 0);
+        if(c)
+        {
+            CLASS_MAINSIGNALIN(c, t_pa_readstream_tilde, m_f);
+            class_addmethod(c, (t_method)pa_readstream_tilde_dsp, gensym("dsp"), A_CANT);
+            class_addmethod(c, (t_method)pa_readstream_tilde_open, gensym("open"), A_GIMME, 0);
+            class_addmethod(c, (t_method)pa_readstream_tilde_stop, gensym("stop"), A_NULL);
+            class_addmethod(c, (t_method)pa_readstream_tilde_status, gensym("status"), A_NULL);
+        }
+
+        pa_readstream_tilde_class = c;
+    }
+}